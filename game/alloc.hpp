@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <new>
+
+#define ALLOC_H
+
+//Heap allocations counted on one thread
+struct AllocStats
+{
+    uint64_t count;
+    uint64_t bytes;
+};
+
+//What an allocation inside a strict scope does
+enum AllocStrict
+{
+    STRICT_OFF,
+    STRICT_LOG,
+    STRICT_ABORT
+};
+
+//Strict mode reports printed before it goes quiet
+const int ALLOC_REPORTS = 32;
+
+//Allocations made by the calling thread
+thread_local AllocStats allocStats = {0, 0};
+
+//Name of the strict scope the calling thread is in, NULL outside of one
+thread_local const char *allocScope = NULL;
+
+//Strict mode, set once at startup
+AllocStrict allocStrictMode = STRICT_OFF;
+
+//Reports left in strict log mode
+int allocReportsLeft = ALLOC_REPORTS;
+
+//Check if the allocator hook is compiled in, build with -DTRACK_ALLOCATIONS to count
+bool allocTracking()
+{
+#ifdef TRACK_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+//Get the allocations of the calling thread so far
+AllocStats allocSnapshot()
+{
+    return allocStats;
+}
+
+//Get the allocations made between two snapshots
+AllocStats allocSince(AllocStats start)
+{
+    AllocStats now = allocStats;
+    AllocStats delta = { now.count - start.count, now.bytes - start.bytes };
+    return delta;
+}
+
+//Count one allocation and enforce strict mode
+void allocCount(size_t size)
+{
+    allocStats.count++;
+    allocStats.bytes += size;
+    if (allocScope == NULL || allocStrictMode == STRICT_OFF)
+        return;
+
+    //Printing may allocate, so leave the scope while reporting
+    const char *scope = allocScope;
+    allocScope = NULL;
+    if (allocReportsLeft > 0)
+    {
+        allocReportsLeft--;
+        fprintf(stderr, "Heap allocation of %zu bytes inside %s!\n", size, scope);
+    }
+    if (allocStrictMode == STRICT_ABORT)
+        abort();
+    allocScope = scope;
+}
+
+//Turn strict mode on from a command line value, "abort" aborts and anything else logs
+void setAllocStrict(const char *mode)
+{
+    allocStrictMode = strcmp(mode, "abort") == 0 ? STRICT_ABORT : STRICT_LOG;
+    if (!allocTracking())
+        printf("Strict allocation mode needs a build with -DTRACK_ALLOCATIONS!\n");
+}
+
+//Marks the rest of a scope as one that must not allocate, NULL lifts an enclosing one
+class AllocScope
+{
+    public:
+        //Constructor, name must outlive the scope
+        AllocScope(const char *name);
+
+        //Destructor
+        ~AllocScope();
+
+    private:
+        //Scope active before this one
+        const char *previous;
+};
+
+AllocScope::AllocScope(const char *name)
+{
+    previous = allocScope;
+    allocScope = name;
+}
+
+AllocScope::~AllocScope()
+{
+    allocScope = previous;
+}
+
+#ifdef TRACK_ALLOCATIONS
+//Replacements of the global allocation functions that count every call
+void *operator new(size_t size)
+{
+    allocCount(size);
+    void *p = malloc(size ? size : 1);
+    if (p == NULL)
+        throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    allocCount(size);
+    return malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    free(p);
+}
+#endif
@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <SDL2/SDL.h>
+#include <vector>
+
+#define BATCH_H
+
+//SDL_RenderGeometry arrived in SDL 2.0.18, older versions copy each quad instead
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+#define BATCH_GEOMETRY
+#endif
+
+//Collects textured quads from one texture and draws them together
+class BlockBatch
+{
+    public:
+        //Constructor
+        BlockBatch();
+
+        //Reserve room for a number of quads
+        void reserve(int quads);
+
+        //Forget the queued quads, keeping the buffers
+        void clear();
+
+        //Queue a quad copying clip of the texture to dst, faded by alpha
+        void add(const SDL_Rect &clip, const SDL_Rect &dst, Uint8 alpha = 0xFF);
+
+        //Draw every queued quad from the texture
+        void draw(SDL_Renderer *gRenderer, SDL_Texture *texture, int textureWidth, int textureHeight);
+
+        //Get the number of queued quads
+        int size();
+
+    private:
+        //Queued quads
+        std::vector<SDL_Rect> clips;
+        std::vector<SDL_Rect> dsts;
+        std::vector<Uint8> alphas;
+
+        #if defined(BATCH_GEOMETRY)
+        //Vertex buffer rebuilt on every draw
+        std::vector<SDL_Vertex> vertices;
+
+        //Two triangles per quad, only grows when more quads are queued than ever before
+        std::vector<int> indices;
+        #endif
+};
+
+BlockBatch::BlockBatch()
+{
+}
+
+void BlockBatch::reserve(int quads)
+{
+    clips.reserve(quads);
+    dsts.reserve(quads);
+    alphas.reserve(quads);
+    #if defined(BATCH_GEOMETRY)
+    vertices.reserve(quads * 4);
+    indices.reserve(quads * 6);
+    #endif
+}
+
+void BlockBatch::clear()
+{
+    clips.clear();
+    dsts.clear();
+    alphas.clear();
+}
+
+void BlockBatch::add(const SDL_Rect &clip, const SDL_Rect &dst, Uint8 alpha)
+{
+    clips.push_back(clip);
+    dsts.push_back(dst);
+    alphas.push_back(alpha);
+}
+
+int BlockBatch::size()
+{
+    return (int)clips.size();
+}
+
+void BlockBatch::draw(SDL_Renderer *gRenderer, SDL_Texture *texture, int textureWidth, int textureHeight)
+{
+    int quads = size();
+    if (quads == 0 || texture == NULL)
+        return;
+
+    #if defined(BATCH_GEOMETRY)
+    //Indices only depend on the quad count
+    for (int i = indices.size() / 6; i < quads; i++)
+    {
+        int v = i * 4;
+        int quad[6] = { v, v + 1, v + 2, v + 2, v + 3, v };
+        indices.insert(indices.end(), quad, quad + 6);
+    }
+
+    vertices.resize(quads * 4);
+    for (int i = 0; i < quads; i++)
+    {
+        float x0 = dsts[i].x, y0 = dsts[i].y;
+        float x1 = x0 + dsts[i].w, y1 = y0 + dsts[i].h;
+        float u0 = (float)clips[i].x / textureWidth, v0 = (float)clips[i].y / textureHeight;
+        float u1 = (float)(clips[i].x + clips[i].w) / textureWidth, v1 = (float)(clips[i].y + clips[i].h) / textureHeight;
+
+        SDL_Vertex *v = &vertices[i * 4];
+        v[0].position.x = x0; v[0].position.y = y0; v[0].tex_coord.x = u0; v[0].tex_coord.y = v0;
+        v[1].position.x = x1; v[1].position.y = y0; v[1].tex_coord.x = u1; v[1].tex_coord.y = v0;
+        v[2].position.x = x1; v[2].position.y = y1; v[2].tex_coord.x = u1; v[2].tex_coord.y = v1;
+        v[3].position.x = x0; v[3].position.y = y1; v[3].tex_coord.x = u0; v[3].tex_coord.y = v1;
+        SDL_Color color = { 0xFF, 0xFF, 0xFF, alphas[i] };
+        for (int j = 0; j < 4; j++)
+            v[j].color = color;
+    }
+
+    if (SDL_RenderGeometry(gRenderer, texture, &vertices[0], quads * 4, &indices[0], quads * 6) == 0)
+        return;
+    #else
+    //Copies work in pixels, the texture size is only needed for the coordinates of the vertices
+    (void)textureWidth;
+    (void)textureHeight;
+    #endif
+
+    //Copies from one texture still get merged by SDL's own render batching, so the alpha is only set when it changes
+    Uint8 alpha = 0xFF;
+    SDL_SetTextureAlphaMod(texture, alpha);
+    for (int i = 0; i < quads; i++)
+    {
+        if (alphas[i] != alpha)
+        {
+            alpha = alphas[i];
+            SDL_SetTextureAlphaMod(texture, alpha);
+        }
+        SDL_RenderCopy(gRenderer, texture, &clips[i], &dsts[i]);
+    }
+    if (alpha != 0xFF)
+        SDL_SetTextureAlphaMod(texture, 0xFF);
+}
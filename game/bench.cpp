@@ -0,0 +1,301 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "core.hpp"
+#include "placement.hpp"
+
+//Reaches the private steps of GameCore, which it lets in as a friend
+class CoreBench
+{
+    public:
+        //Replace the stack of a game
+        static void setBoard(GameCore &core, const Board &board);
+
+        //Deal the next shape the way a lock does
+        static void spawn(GameCore &core);
+};
+
+void CoreBench::setBoard(GameCore &core, const Board &board)
+{
+    core.board = board;
+}
+
+void CoreBench::spawn(GameCore &core)
+{
+    core.createNewShape();
+}
+
+//Each benchmark doubles its iterations until one run takes at least this long
+const double DEFAULT_MIN_SECONDS = 0.2;
+
+//Results are folded in here so the compiler cannot drop the work
+volatile uint64_t benchSink;
+
+//Timing of one benchmark
+struct BenchResult
+{
+    std::string name;
+    long iterations;
+    double seconds;
+
+    //Heap allocations of the timed run
+    AllocStats allocs;
+};
+
+//Run body(iterations) with growing counts until it is slow enough to time reliably
+template <typename Body>
+BenchResult runBench(const char *name, double minSeconds, Body body)
+{
+    BenchResult result = {name, 0, 0, {0, 0}};
+    for (long iterations = 1024;; iterations *= 2)
+    {
+        AllocStats allocs = allocSnapshot();
+        auto begin = std::chrono::steady_clock::now();
+        body(iterations);
+        auto end = std::chrono::steady_clock::now();
+
+        result.allocs = allocSince(allocs);
+        result.iterations = iterations;
+        result.seconds = std::chrono::duration<double>(end - begin).count();
+        if (result.seconds >= minSeconds)
+            return result;
+    }
+}
+
+//A stack like one from the middle of a game: the bottom rows filled with a few holes each
+Board makeStack(uint32_t seed)
+{
+    Board board;
+    Random random(seed);
+    const uint16_t cell[1] = {1};
+    for (int y = GRID_HEIGHT - 12; y < GRID_HEIGHT; y++)
+        for (int x = 0; x < GRID_WIDTH; x++)
+            if (random.below(5) != 0)
+                board.place(cell, 1, x, y, Colors(random.below(COLOR_TOTAL)));
+    return board;
+}
+
+//The same stack with its four bottom rows complete
+Board makeClearStack(uint32_t seed)
+{
+    Board board = makeStack(seed);
+    const uint16_t row[1] = {FULL_ROW};
+    board.place(row, 1, 0, GRID_HEIGHT - 4, BLUE);
+    board.place(row, 1, 0, GRID_HEIGHT - 3, GREEN);
+    board.place(row, 1, 0, GRID_HEIGHT - 2, PURPLE);
+    board.place(row, 1, 0, GRID_HEIGHT - 1, PINK);
+    return board;
+}
+
+//Print the results as one JSON document
+void printJson(const std::vector<BenchResult> &results)
+{
+    printf("{\n  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchResult &r = results[i];
+        printf("    {\"name\": \"%s\", \"iterations\": %ld, \"seconds\": %.6f, \"ns_per_op\": %.3f, \"ops_per_s\": %.0f",
+               r.name.c_str(), r.iterations, r.seconds, r.seconds * 1e9 / r.iterations, r.iterations / r.seconds);
+        if (allocTracking())
+            printf(", \"allocs_per_op\": %.6f, \"bytes_per_op\": %.3f", (double)r.allocs.count / r.iterations,
+                   (double)r.allocs.bytes / r.iterations);
+        printf("}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    printf("  ]\n}\n");
+}
+
+int main(int argc, char *args[])
+{
+    double minSeconds = DEFAULT_MIN_SECONDS;
+    std::string filter;
+
+    //Command line options
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(args[i], "--min-time") == 0 && i + 1 < argc)
+            minSeconds = atof(args[++i]);
+        else if (strcmp(args[i], "--filter") == 0 && i + 1 < argc)
+            filter = args[++i];
+        else
+        {
+            printf("Usage: %s [--min-time SECONDS] [--filter NAME]\n", args[0]);
+            return 1;
+        }
+    }
+
+    const Board stack = makeStack(1);
+    const Board clearStack = makeClearStack(1);
+    std::vector<BenchResult> results;
+    auto wanted = [&](const char *name) { return filter.empty() || strstr(name, filter.c_str()) != NULL; };
+
+    //Shape moves above the stack, restarting from a different column every time
+    if (wanted("move_left"))
+        results.push_back(runBench("move_left", minSeconds, [&](long n) {
+            Shape shape(T_SHAPE);
+            uint64_t sink = 0;
+            for (long i = 0; i < n; i++)
+            {
+                int x, y;
+                shape.setRelativePosition(1 + i % (GRID_WIDTH - 3), 10);
+                shape.moveLeft(stack);
+                shape.getRelativePosition(x, y);
+                sink += x;
+            }
+            benchSink += sink;
+        }));
+
+    if (wanted("move_right"))
+        results.push_back(runBench("move_right", minSeconds, [&](long n) {
+            Shape shape(T_SHAPE);
+            uint64_t sink = 0;
+            for (long i = 0; i < n; i++)
+            {
+                int x, y;
+                shape.setRelativePosition(i % (GRID_WIDTH - 2), 10);
+                shape.moveRight(stack);
+                shape.getRelativePosition(x, y);
+                sink += x;
+            }
+            benchSink += sink;
+        }));
+
+    if (wanted("move_down"))
+        results.push_back(runBench("move_down", minSeconds, [&](long n) {
+            Shape shape(L_SHAPE);
+            uint64_t sink = 0;
+            for (long i = 0; i < n; i++)
+            {
+                int x, y;
+                shape.setRelativePosition(i % (GRID_WIDTH - 2), 10 + i % 8);
+                shape.moveDown(stack);
+                shape.getRelativePosition(x, y);
+                sink += y;
+            }
+            benchSink += sink;
+        }));
+
+    //Dropping from the top of the grid onto the stack, which a row by row descent would take around twenty steps for
+    if (wanted("hard_drop"))
+        results.push_back(runBench("hard_drop", minSeconds, [&](long n) {
+            uint64_t sink = 0;
+            for (long i = 0; i < n; i++)
+            {
+                int x, y;
+                Shape shape(Shapes(i % SHAPE_TOTAL));
+                shape.setRelativePosition(i % (GRID_WIDTH - 3), 0);
+                shape.hardDrop(stack);
+                shape.getRelativePosition(x, y);
+                sink += y;
+            }
+            benchSink += sink;
+        }));
+
+    //Rotation of the I shape, which has the longest kick table, just above the stack
+    if (wanted("rotate"))
+        results.push_back(runBench("rotate", minSeconds, [&](long n) {
+            Shape shape(I_SHAPE);
+            uint64_t sink = 0;
+            for (long i = 0; i < n; i++)
+            {
+                int x, y;
+                if ((i & 3) == 0)
+                    shape.setRelativePosition((i >> 2) % (GRID_WIDTH - 3), 14);
+                shape.rotateByPi2(stack);
+                shape.getRelativePosition(x, y);
+                sink += x + y;
+            }
+            benchSink += sink;
+        }));
+
+    //Raw mask collision against the stack over every column and a range of heights
+    if (wanted("collides"))
+        results.push_back(runBench("collides", minSeconds, [&](long n) {
+            const uint16_t *mask = getOrientation(T_SHAPE, 0).mask;
+            uint64_t sink = 0;
+            for (long i = 0; i < n; i++)
+                sink += stack.collides(mask, SHAPE_BOX, i % GRID_WIDTH - 1, 12 + (i >> 4) % 16);
+            benchSink += sink;
+        }));
+
+    //Copying a board is part of the line clear benchmark, so it is timed on its own too
+    if (wanted("board_copy"))
+        results.push_back(runBench("board_copy", minSeconds, [&](long n) {
+            uint64_t sink = 0;
+            for (long i = 0; i < n; i++)
+            {
+                Board board = clearStack;
+                sink += board.getRow(i % GRID_HEIGHT);
+            }
+            benchSink += sink;
+        }));
+
+    //A four line clear under a full stack, including the copy that restores the board
+    if (wanted("clear_lines"))
+        results.push_back(runBench("clear_lines", minSeconds, [&](long n) {
+            uint64_t sink = 0;
+            for (long i = 0; i < n; i++)
+            {
+                Board board = clearStack;
+                sink += board.clearLines(GRID_HEIGHT - SHAPE_BOX, SHAPE_BOX).count;
+                sink += board.getRow(i % GRID_HEIGHT);
+            }
+            benchSink += sink;
+        }));
+
+    //GameCore::createNewShape over the stack: deal from the bag, build the shape and test the spawn
+    if (wanted("spawn"))
+        results.push_back(runBench("spawn", minSeconds, [&](long n) {
+            GameCore core(1);
+            CoreBench::setBoard(core, stack);
+            uint64_t sink = 0;
+            for (long i = 0; i < n; i++)
+            {
+                CoreBench::spawn(core);
+                sink += core.getShape().getType() + core.isOver();
+            }
+            benchSink += sink;
+        }));
+
+    //Every lock position of a freshly spawned shape, cycling through the shape types
+    const Board emptyBoard;
+    PlacementGenerator generator;
+    PlacementList placements;
+    if (wanted("placements_empty"))
+        results.push_back(runBench("placements_empty", minSeconds, [&](long n) {
+            uint64_t sink = 0;
+            for (long i = 0; i < n; i++)
+                sink += generator.generate(emptyBoard, Shape(Shapes(i % SHAPE_TOTAL)), placements);
+            benchSink += sink;
+        }));
+
+    if (wanted("placements_stack"))
+        results.push_back(runBench("placements_stack", minSeconds, [&](long n) {
+            uint64_t sink = 0;
+            for (long i = 0; i < n; i++)
+                sink += generator.generate(stack, Shape(Shapes(i % SHAPE_TOTAL)), placements);
+            benchSink += sink;
+        }));
+
+    //Whole games with the headless input pattern, one op is one simulation step
+    if (wanted("headless_game"))
+        results.push_back(runBench("headless_game", minSeconds, [&](long n) {
+            uint32_t seed = 1;
+            GameCore core(seed);
+            uint32_t noise = 2654435762u;
+            for (long i = 0; i < n; i++)
+            {
+                if (core.isOver())
+                    core.reset(++seed);
+
+                core.step(noiseInputs(noise), STEP_DT);
+            }
+            benchSink += core.getBoard().hash();
+        }));
+
+    printJson(results);
+    return 0;
+}
@@ -0,0 +1,315 @@
+#include <stdint.h>
+#include <string.h>
+
+#ifndef DEFS_H
+#include "defs.hpp"
+#endif
+
+#ifndef SERIAL_H
+#include "serial.hpp"
+#endif
+
+#define BOARD_H
+
+//Columns of padding on each side of a row mask so shapes can be shifted off the grid
+const int BOARD_WALL = 4;
+
+//Bits of the playfield inside a padded row
+const uint32_t BOARD_FIELD = ((1u << GRID_WIDTH) - 1) << BOARD_WALL;
+
+//Bits of the walls inside a padded row
+const uint32_t BOARD_WALLS = ~BOARD_FIELD;
+
+//Mask of a complete row
+const uint16_t FULL_ROW = (1u << GRID_WIDTH) - 1;
+
+//Rows removed by a line clear
+struct LineClear
+{
+    //Number of rows removed
+    int count;
+
+    //Bit y is set for every removed row
+    uint32_t rows;
+};
+
+//The settled stack: one occupancy mask per row plus a color per cell
+class Board
+{
+    public:
+        //Constructor
+        Board();
+
+        //Empty the board
+        void clear();
+
+        //Check if a shape mask with its top left cell at (x, y) overlaps the stack or the walls
+        bool collides(const uint16_t *mask, int height, int x, int y) const;
+
+        //Write a shape mask with its top left cell at (x, y) into the board
+        void place(const uint16_t *mask, int height, int x, int y, Colors color);
+
+        //Rows a shape mask that fits at (x, y) can fall before it lands
+        int dropDistance(const uint16_t *mask, int height, int x, int y) const;
+
+        //Remove the full rows among the ones a locked shape touched and drop the rows above
+        LineClear clearLines(int top, int height);
+
+        //Check if a row is full
+        bool isRowFull(int y) const;
+
+        //Check if a cell is filled
+        bool isFilled(int x, int y) const;
+
+        //Get the color of a cell, -1 if empty
+        int getColor(int x, int y) const;
+
+        //Get the occupancy mask of a row
+        uint16_t getRow(int y) const;
+
+        //Get an FNV-1a hash of the rows and colors
+        uint64_t hash() const;
+
+        //Get an FNV-1a hash of the rows alone, boards that differ only in color hash the same
+        uint64_t hashRows() const;
+
+        //Get a row padded with walls, rows above the grid are open and rows below are solid
+        uint32_t paddedRow(int y) const;
+
+        //Append the rows and the colors of the filled cells
+        void writeState(StateWriter &out) const;
+
+        //Restore a state written by writeState, false if a row or a color is out of range
+        bool readState(StateReader &in);
+
+    private:
+        //Derive the column masks from the rows, for restored states only
+        void rebuildColumns();
+
+        //Column masks, bit y is set when row y of the column is filled
+        uint32_t columns[GRID_WIDTH];
+
+        //Occupancy masks, bit x is set when column x is filled
+        uint16_t rows[GRID_HEIGHT];
+
+        //Color plane, 0 is empty otherwise color + 1
+        uint8_t colors[GRID_HEIGHT][GRID_WIDTH];
+};
+
+//Settled blocks live only here, one mask per row and column and one byte per cell, so memory never grows during a game
+static_assert(sizeof(Board) == (GRID_WIDTH * sizeof(uint32_t) + GRID_HEIGHT * sizeof(uint16_t) + GRID_HEIGHT * GRID_WIDTH + 3) / 4 * 4,
+              "Board must stay a flat fixed-size plane");
+static_assert(GRID_HEIGHT < 32, "Column masks need a spare bit for the floor");
+
+Board::Board()
+{
+    clear();
+}
+
+void Board::clear()
+{
+    memset(columns, 0, sizeof(columns));
+    memset(rows, 0, sizeof(rows));
+    memset(colors, 0, sizeof(colors));
+}
+
+uint32_t Board::paddedRow(int y) const
+{
+    if (y < 0)
+        return BOARD_WALLS;
+    if (y >= GRID_HEIGHT)
+        return ~0u;
+    return ((uint32_t)rows[y] << BOARD_WALL) | BOARD_WALLS;
+}
+
+bool Board::collides(const uint16_t *mask, int height, int x, int y) const
+{
+    if (x < -BOARD_WALL)
+        return true;
+
+    uint32_t hit = 0;
+    for (int i = 0; i < height; i++)
+        hit |= paddedRow(y + i) & ((uint32_t)mask[i] << (x + BOARD_WALL));
+    return hit != 0;
+}
+
+void Board::place(const uint16_t *mask, int height, int x, int y, Colors color)
+{
+    for (int i = 0; i < height; i++)
+    {
+        int row = y + i;
+        if (mask[i] == 0 || row < 0 || row >= GRID_HEIGHT)
+            continue;
+
+        uint32_t bits = (((uint32_t)mask[i] << (x + BOARD_WALL)) & BOARD_FIELD) >> BOARD_WALL;
+        rows[row] |= bits;
+        while (bits)
+        {
+            int column = __builtin_ctz(bits);
+            colors[row][column] = color + 1;
+            columns[column] |= 1u << row;
+            bits &= bits - 1;
+        }
+    }
+}
+
+int Board::dropDistance(const uint16_t *mask, int height, int x, int y) const
+{
+    //Only the lowest cell of each column of the shape can land, so walk the mask bottom up
+    int distance = GRID_HEIGHT;
+    uint16_t seen = 0;
+    for (int i = height - 1; i >= 0; i--)
+    {
+        uint16_t bits = mask[i] & ~seen;
+        seen |= mask[i];
+        while (bits)
+        {
+            int column = x + __builtin_ctz(bits);
+            bits &= bits - 1;
+            if (column < 0 || column >= GRID_WIDTH)
+                return 0;
+
+            //First filled cell below, the floor counts as row GRID_HEIGHT
+            uint64_t below = columns[column] | (1ull << GRID_HEIGHT);
+            int shift = y + i + 1;
+            below = shift >= 0 ? below >> shift : below << -shift;
+            int fall = __builtin_ctzll(below);
+            if (fall < distance)
+                distance = fall;
+        }
+    }
+    return distance;
+}
+
+void Board::rebuildColumns()
+{
+    memset(columns, 0, sizeof(columns));
+    for (int y = 0; y < GRID_HEIGHT; y++)
+        for (uint32_t bits = rows[y]; bits; bits &= bits - 1)
+            columns[__builtin_ctz(bits)] |= 1u << y;
+}
+
+LineClear Board::clearLines(int top, int height)
+{
+    LineClear clear = {0, 0};
+    int bottom = top + height - 1;
+    if (top < 0)
+        top = 0;
+    if (bottom >= GRID_HEIGHT)
+        bottom = GRID_HEIGHT - 1;
+
+    for (int y = top; y <= bottom; y++)
+        if (rows[y] == FULL_ROW)
+        {
+            clear.rows |= 1u << y;
+            clear.count++;
+        }
+
+    if (clear.count == 0)
+        return clear;
+
+    //Compact the touched rows from the bottom up
+    int write = bottom;
+    for (int y = bottom; y >= top; y--)
+    {
+        if (clear.rows & (1u << y))
+            continue;
+        if (write != y)
+        {
+            rows[write] = rows[y];
+            memcpy(colors[write], colors[y], sizeof(colors[y]));
+        }
+        write--;
+    }
+
+    //Everything above the touched rows drops as one block
+    memmove(&rows[clear.count], &rows[0], top * sizeof(rows[0]));
+    memmove(colors[clear.count], colors[0], top * sizeof(colors[0]));
+    memset(&rows[0], 0, clear.count * sizeof(rows[0]));
+    memset(colors[0], 0, clear.count * sizeof(colors[0]));
+
+    //Columns get the same move: rows under the touched ones stay, rows above drop as one block
+    //and the few kept touched rows, now at the bottom of the window, are written back from the rows
+    uint32_t under = ~((2u << bottom) - 1);
+    uint32_t above = (1u << top) - 1;
+    for (int x = 0; x < GRID_WIDTH; x++)
+        columns[x] = (columns[x] & under) | (columns[x] & above) << clear.count;
+    for (int y = top + clear.count; y <= bottom; y++)
+        for (uint32_t bits = rows[y]; bits; bits &= bits - 1)
+            columns[__builtin_ctz(bits)] |= 1u << y;
+    return clear;
+}
+
+bool Board::isRowFull(int y) const
+{
+    return rows[y] == FULL_ROW;
+}
+
+bool Board::isFilled(int x, int y) const
+{
+    return (rows[y] >> x) & 1;
+}
+
+int Board::getColor(int x, int y) const
+{
+    return colors[y][x] - 1;
+}
+
+uint16_t Board::getRow(int y) const
+{
+    return rows[y];
+}
+
+uint64_t Board::hash() const
+{
+    uint64_t h = 0xCBF29CE484222325ull;
+    const uint8_t *bytes = (const uint8_t *)rows;
+    for (size_t i = 0; i < sizeof(rows); i++)
+        h = (h ^ bytes[i]) * 0x100000001B3ull;
+    bytes = &colors[0][0];
+    for (size_t i = 0; i < sizeof(colors); i++)
+        h = (h ^ bytes[i]) * 0x100000001B3ull;
+    return h;
+}
+
+uint64_t Board::hashRows() const
+{
+    uint64_t h = 0xCBF29CE484222325ull;
+    const uint8_t *bytes = (const uint8_t *)rows;
+    for (size_t i = 0; i < sizeof(rows); i++)
+        h = (h ^ bytes[i]) * 0x100000001B3ull;
+    return h;
+}
+
+void Board::writeState(StateWriter &out) const
+{
+    //Empty cells are implied by the rows, so only filled cells carry a color
+    for (int y = 0; y < GRID_HEIGHT; y++)
+        out.u16(rows[y]);
+    for (int y = 0; y < GRID_HEIGHT; y++)
+        for (uint32_t bits = rows[y]; bits; bits &= bits - 1)
+            out.u8(colors[y][__builtin_ctz(bits)]);
+}
+
+bool Board::readState(StateReader &in)
+{
+    clear();
+    for (int y = 0; y < GRID_HEIGHT; y++)
+    {
+        uint16_t row = in.u16();
+        if (row & ~FULL_ROW)
+            return false;
+        rows[y] = row;
+    }
+    for (int y = 0; y < GRID_HEIGHT; y++)
+        for (uint32_t bits = rows[y]; bits; bits &= bits - 1)
+        {
+            //Filled cells hold a color + 1
+            uint8_t color = in.u8();
+            if (color < 1 || color > COLOR_TOTAL)
+                return false;
+            colors[y][__builtin_ctz(bits)] = color;
+        }
+    rebuildColumns();
+    return true;
+}
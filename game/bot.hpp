@@ -0,0 +1,620 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef CORE_H
+#include "core.hpp"
+#endif
+
+#ifndef PLACEMENT_H
+#include "placement.hpp"
+#endif
+
+#ifndef TRACE_H
+#include "trace.hpp"
+#endif
+
+#define BOT_H
+
+//Boards kept after each shape of the search
+const int BOT_BEAM = 32;
+
+//Widest beam allowed, the candidate buffers take about 70 KB per kept board
+const int BOT_MAX_BEAM = 256;
+
+//Shapes searched, the current one and the previews after it
+const int BOT_DEPTH = 3;
+
+//Seconds the bot may think about one shape, the first shape always scores at least a few placements
+const double BOT_BUDGET = 0.010;
+
+//Placements scored between reads of the clock
+const int BOT_CLOCK_PLACEMENTS = 16;
+
+//Board evaluation weights, a well known hand tuned set
+const float BOT_HEIGHT_WEIGHT = -0.510066f;
+const float BOT_LINES_WEIGHT = 0.760666f;
+const float BOT_HOLES_WEIGHT = -0.35663f;
+const float BOT_BUMPINESS_WEIGHT = -0.184483f;
+
+//Shape states a path can pass through, indexed by orientation, box row and padded column
+const int BOT_STATES = ROTATION_TOTAL * PLACEMENT_ROWS * 32;
+
+//A board kept by the search
+struct BotNode
+{
+    Board board;
+
+    //Line reward collected on the way plus the evaluation of the board
+    float score;
+    float reward;
+
+    //Placement of the current shape this board descends from
+    Placement first;
+};
+
+//One placement of a kept board, scored but not kept yet
+struct BotCandidate
+{
+    float score;
+    float reward;
+    uint64_t hash;
+    Placement placement;
+};
+
+//Plays the game through the same inputs a player would press
+//For every new shape it beam searches the placements of the shape and the previews,
+//spreading the boards of each depth across a pool of threads, then walks the chosen placement in
+class Bot
+{
+    public:
+        //Constructor, 0 threads uses every core
+        Bot(int threads = 0, int beamWidth = BOT_BEAM, int depth = BOT_DEPTH, double budget = BOT_BUDGET);
+
+        //Destructor
+        ~Bot();
+
+        //Get the inputs for the next simulation step
+        uint8_t next(const GameCore &core);
+
+        //Get the number of shapes thought about
+        int getPieces() const;
+
+        //Get the total and the longest thinking time in seconds
+        double getThinkSeconds() const;
+        double getMaxThinkSeconds() const;
+
+        //Get the number of threads searching
+        int getThreads() const;
+
+        //Get the number of boards kept per shape
+        int getBeamWidth() const;
+
+    private:
+        //Pick the placement of the current shape before the deadline, false if nothing fits
+        bool think(const GameCore &core);
+
+        //Score the placements of the kept boards for one depth on every thread
+        void runDepth();
+
+        //Score the placements of the kept boards handed to this thread
+        void expand(int worker);
+
+        //Keep the best distinct boards of a depth, false if the depth ran out of time or every board died
+        bool keepBest(int depth);
+
+        //Worker thread loop
+        void work(int worker);
+
+        //Score a board
+        static float evaluate(const Board &board);
+
+        //Find the inputs that move the shape to the target, false if it cannot get there
+        bool planPath(const Board &board, const Shape &shape);
+
+        //Index of a shape state, -1 outside the searched area
+        static int stateKey(const Shape &shape);
+
+        //Position of a move among the inputs of one GameCore::step
+        static int stepOrder(uint8_t move);
+
+        //Search settings
+        int beamWidth;
+        int depth;
+        double budget;
+
+        //Boards kept after the last depth and the ones being chosen
+        std::vector<BotNode> beam;
+        std::vector<BotNode> nextBeam;
+        int beamSize;
+
+        //Placements of kept board i live at i * MAX_PLACEMENTS
+        std::vector<BotCandidate> candidates;
+        std::vector<int> counts;
+        std::vector<int> order;
+
+        //Shape of the depth being searched, the first depth starts where the shape is
+        Shape rootShape;
+        Shapes depthShape;
+        int depthIndex;
+
+        //Work handed out to the threads
+        std::atomic<int> nextNode;
+        std::atomic<bool> expired;
+        std::chrono::steady_clock::time_point deadline;
+
+        //One generator per thread
+        std::vector<PlacementGenerator> generators;
+        std::vector<PlacementList> lists;
+
+        //Thread pool, the calling thread is worker 0
+        std::vector<std::thread> pool;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable finished;
+        int generation;
+        int busy;
+        bool quitting;
+
+        //Placement being walked in and the inputs that get there
+        Placement target;
+        bool hasTarget;
+        std::vector<uint8_t> path;
+        std::vector<int> pathStates;
+        int pathLength;
+        int pathStep;
+
+        //Breadth first search over shape states
+        std::vector<Shape> queue;
+        std::vector<int> parents;
+        std::vector<uint8_t> moves;
+
+        //Shape number the target was chosen for
+        int piece;
+
+        //Statistics
+        int pieces;
+        double thinkSeconds;
+        double maxThinkSeconds;
+};
+
+Bot::Bot(int threads, int beamWidth, int depth, double budget)
+{
+    if (threads <= 0)
+        threads = std::thread::hardware_concurrency();
+    if (threads < 1)
+        threads = 1;
+    if (beamWidth < 1)
+        beamWidth = 1;
+    if (beamWidth > BOT_MAX_BEAM)
+        beamWidth = BOT_MAX_BEAM;
+
+    //Previews past the bag lookahead are unknown
+    if (depth < 1)
+        depth = 1;
+    if (depth > BAG_LOOKAHEAD + 1)
+        depth = BAG_LOOKAHEAD + 1;
+
+    this->beamWidth = beamWidth;
+    this->depth = depth;
+    this->budget = budget;
+
+    //Everything is sized up front so thinking never touches the heap
+    beam.resize(beamWidth);
+    nextBeam.resize(beamWidth);
+    beamSize = 0;
+    candidates.resize((size_t)beamWidth * MAX_PLACEMENTS);
+    counts.resize(beamWidth);
+    order.reserve((size_t)beamWidth * MAX_PLACEMENTS);
+    depthShape = S_SHAPE;
+    depthIndex = 0;
+    nextNode = 0;
+    expired = false;
+
+    generators.resize(threads);
+    lists.resize(threads);
+    generation = 0;
+    busy = 0;
+    quitting = false;
+    for (int i = 1; i < threads; i++)
+        pool.push_back(std::thread(&Bot::work, this, i));
+
+    hasTarget = false;
+    path.resize(BOT_STATES);
+    pathStates.resize(BOT_STATES);
+    pathLength = 0;
+    pathStep = 0;
+    queue.resize(BOT_STATES);
+    parents.resize(BOT_STATES);
+    moves.resize(BOT_STATES);
+
+    piece = -1;
+    pieces = 0;
+    thinkSeconds = 0;
+    maxThinkSeconds = 0;
+}
+
+Bot::~Bot()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quitting = true;
+    }
+    wake.notify_all();
+    for (std::thread &thread: pool)
+        thread.join();
+}
+
+int Bot::getPieces() const
+{
+    return pieces;
+}
+
+double Bot::getThinkSeconds() const
+{
+    return thinkSeconds;
+}
+
+double Bot::getMaxThinkSeconds() const
+{
+    return maxThinkSeconds;
+}
+
+int Bot::getThreads() const
+{
+    return generators.size();
+}
+
+int Bot::getBeamWidth() const
+{
+    return beamWidth;
+}
+
+float Bot::evaluate(const Board &board)
+{
+    //Column heights and the empty cells under them, one row at a time
+    int heights[GRID_WIDTH] = {0};
+    uint32_t seen = 0;
+    int holes = 0;
+    for (int y = 0; y < GRID_HEIGHT; y++)
+    {
+        uint32_t row = board.getRow(y);
+        holes += __builtin_popcount(~row & seen & FULL_ROW);
+        for (uint32_t fresh = row & ~seen; fresh; fresh &= fresh - 1)
+            heights[__builtin_ctz(fresh)] = GRID_HEIGHT - y;
+        seen |= row;
+    }
+
+    int height = 0, bumpiness = 0;
+    for (int x = 0; x < GRID_WIDTH; x++)
+    {
+        height += heights[x];
+        if (x > 0)
+            bumpiness += abs(heights[x] - heights[x - 1]);
+    }
+    return BOT_HEIGHT_WEIGHT * height + BOT_HOLES_WEIGHT * holes + BOT_BUMPINESS_WEIGHT * bumpiness;
+}
+
+void Bot::work(int worker)
+{
+    int seen = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return quitting || generation != seen; });
+            if (quitting)
+                return;
+            seen = generation;
+        }
+
+        expand(worker);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--busy == 0)
+            finished.notify_one();
+    }
+}
+
+void Bot::runDepth()
+{
+    nextNode = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        busy = pool.size();
+        generation++;
+    }
+    wake.notify_all();
+
+    expand(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&] { return busy == 0; });
+}
+
+void Bot::expand(int worker)
+{
+    TRACE_ZONE("Bot::expand");
+    PlacementGenerator &generator = generators[worker];
+    PlacementList &list = lists[worker];
+    int i;
+    while ((i = nextNode++) < beamSize)
+    {
+        counts[i] = 0;
+
+        //Deeper searches give up once the budget is spent
+        if (depthIndex > 0 && (expired || std::chrono::steady_clock::now() > deadline))
+        {
+            expired = true;
+            continue;
+        }
+
+        const BotNode &node = beam[i];
+        Shape shape = depthIndex == 0 ? rootShape : Shape(depthShape);
+        if (shape.checkBlocked(node.board))
+            continue;
+
+        generator.generate(node.board, shape, list);
+        BotCandidate *out = &candidates[(size_t)i * MAX_PLACEMENTS];
+        int j;
+        for (j = 0; j < list.count; j++)
+        {
+            //The clock is read every few placements, the first depth keeps what it scored so far
+            if (j % BOT_CLOCK_PLACEMENTS == BOT_CLOCK_PLACEMENTS - 1 && (expired || std::chrono::steady_clock::now() > deadline))
+            {
+                expired = true;
+                break;
+            }
+
+            Board board = node.board;
+            LineClear clear = lockPlacement(board, depthShape, list.placements[j]);
+            out[j].reward = node.reward + BOT_LINES_WEIGHT * clear.count;
+            out[j].score = out[j].reward + evaluate(board);
+            out[j].hash = board.hashRows();
+            out[j].placement = list.placements[j];
+        }
+        counts[i] = j;
+    }
+}
+
+bool Bot::keepBest(int depth)
+{
+    //A deeper depth cut short would compare boards that saw different amounts of the tree
+    if (depth > 0 && (expired || std::chrono::steady_clock::now() > deadline))
+    {
+        expired = true;
+        return false;
+    }
+
+    order.clear();
+    for (int i = 0; i < beamSize; i++)
+        for (int j = 0; j < counts[i]; j++)
+            order.push_back(i * MAX_PLACEMENTS + j);
+    if (order.empty())
+        return false;
+
+    //Ties go to the earlier board and placement, so the choice does not depend on the threads
+    const std::vector<BotCandidate> &c = candidates;
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        return c[a].score > c[b].score || (c[a].score == c[b].score && a < b);
+    });
+
+    //The same cells reached in another order are kept once
+    int kept = 0;
+    for (size_t k = 0; k < order.size() && kept < beamWidth; k++)
+    {
+        const BotCandidate &candidate = c[order[k]];
+        bool duplicate = false;
+        for (int j = 0; j < kept && !duplicate; j++)
+            duplicate = c[order[j]].hash == candidate.hash;
+        if (duplicate)
+            continue;
+
+        const BotNode &parent = beam[order[k] / MAX_PLACEMENTS];
+        BotNode &node = nextBeam[kept];
+        node.board = parent.board;
+        lockPlacement(node.board, depthShape, candidate.placement);
+        node.score = candidate.score;
+        node.reward = candidate.reward;
+        node.first = depth == 0 ? candidate.placement : parent.first;
+        order[kept++] = order[k];
+    }
+
+    beam.swap(nextBeam);
+    beamSize = kept;
+    return true;
+}
+
+bool Bot::think(const GameCore &core)
+{
+    TRACE_ZONE("Bot::think");
+    auto start = std::chrono::steady_clock::now();
+    expired = false;
+
+    beam[0].board = core.getBoard();
+    beam[0].score = 0;
+    beam[0].reward = 0;
+    beamSize = 1;
+    rootShape = core.getShape();
+
+    //The best board of the deepest finished depth picks the placement
+    bool found = false;
+    for (depthIndex = 0; depthIndex < depth; depthIndex++)
+    {
+        depthShape = depthIndex == 0 ? rootShape.getType() : core.peekShape(depthIndex - 1);
+        runDepth();
+        if (!keepBest(depthIndex))
+            break;
+        found = true;
+    }
+    if (found)
+        target = beam[0].first;
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    thinkSeconds += seconds;
+    if (seconds > maxThinkSeconds)
+        maxThinkSeconds = seconds;
+    return found;
+}
+
+int Bot::stepOrder(uint8_t move)
+{
+    switch (move)
+    {
+        case INPUT_ROTATE: return 0;
+        case INPUT_LEFT: return 1;
+        case INPUT_RIGHT: return 2;
+        case INPUT_DOWN: return 3;
+        default: return 4;
+    }
+}
+
+int Bot::stateKey(const Shape &shape)
+{
+    int x, y;
+    shape.getRelativePosition(x, y);
+    int row = y - PLACEMENT_TOP;
+    if (row < 0 || row >= PLACEMENT_ROWS || x < -BOARD_WALL || x + BOARD_WALL >= 32)
+        return -1;
+    return (shape.getRotation() * PLACEMENT_ROWS + row) * 32 + x + BOARD_WALL;
+}
+
+bool Bot::planPath(const Board &board, const Shape &shape)
+{
+    TRACE_ZONE("Bot::planPath");
+    static const uint8_t MOVES[4] = {INPUT_ROTATE, INPUT_LEFT, INPUT_RIGHT, INPUT_DOWN};
+    int start = stateKey(shape);
+    pathLength = 0;
+    pathStep = 0;
+    if (start < 0)
+        return false;
+
+    //One move at a time through states that do not lock, the same rules the generator searched with
+    //Rotations and side moves are tried first so paths turn high up, where gravity cannot lock the shape halfway
+    std::fill(parents.begin(), parents.end(), -1);
+    parents[start] = start;
+    queue[0] = shape;
+    int head = 0, tail = 1, found = -1;
+    while (head < tail && found < 0)
+    {
+        const Shape current = queue[head++];
+        int key = stateKey(current);
+        int x, y;
+        current.getRelativePosition(x, y);
+        if (x == target.x && y == target.y && current.getRotation() == target.rotation)
+        {
+            found = key;
+            break;
+        }
+        if (current.checkSettled(board))
+            continue;
+
+        for (int m = 0; m < 4; m++)
+        {
+            Shape moved = current;
+            if (MOVES[m] == INPUT_LEFT)
+                moved.moveLeft(board);
+            else if (MOVES[m] == INPUT_RIGHT)
+                moved.moveRight(board);
+            else if (MOVES[m] == INPUT_DOWN)
+                moved.moveDown(board);
+            else
+                moved.flipAngle(board);
+
+            int next = stateKey(moved);
+            if (next < 0 || parents[next] >= 0)
+                continue;
+            parents[next] = key;
+            moves[next] = MOVES[m];
+            queue[tail++] = moved;
+        }
+    }
+    if (found < 0)
+        return false;
+
+    //Walk back from the target, then reverse into step order
+    for (int key = found; key != start; key = parents[key])
+    {
+        path[pathLength] = moves[key];
+        pathStates[pathLength] = key;
+        pathLength++;
+    }
+    std::reverse(path.begin(), path.begin() + pathLength);
+    std::reverse(pathStates.begin(), pathStates.begin() + pathLength);
+
+    //Falling straight onto the stack at the end is one hard drop
+    int drop = pathLength;
+    while (drop > 0 && path[drop - 1] == INPUT_DOWN)
+        drop--;
+    if (drop < pathLength)
+    {
+        path[drop] = INPUT_HARDDROP;
+        pathStates[drop] = found;
+        pathLength = drop + 1;
+    }
+
+    //Moves in the order GameCore::step applies them share a step, like keys pressed together
+    int steps = 0;
+    uint8_t last = INPUT_NONE;
+    for (int i = 0; i < pathLength; i++)
+    {
+        if (steps > 0 && stepOrder(path[i]) > stepOrder(last))
+        {
+            path[steps - 1] |= path[i];
+            pathStates[steps - 1] = pathStates[i];
+        }
+        else
+        {
+            path[steps] = path[i];
+            pathStates[steps] = pathStates[i];
+            steps++;
+        }
+        last = path[i];
+    }
+    pathLength = steps;
+    return true;
+}
+
+uint8_t Bot::next(const GameCore &core)
+{
+    TRACE_ZONE("Bot::next");
+    if (core.isOver())
+        return INPUT_NONE;
+
+    //Every think of one step shares one budget, so a step never runs much past it
+    deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(budget));
+
+    //A new shape gets a new target
+    const Shape &shape = core.getShape();
+    if (core.getPieces() != piece)
+    {
+        piece = core.getPieces();
+        pieces++;
+        hasTarget = think(core);
+        pathLength = 0;
+        pathStep = 0;
+    }
+    if (!hasTarget)
+        return INPUT_HARDDROP;
+
+    //Plan again when gravity moved the shape off the path, and think again from where it is if the target is out of reach
+    int key = stateKey(shape);
+    if (pathStep >= pathLength || (pathStep > 0 && pathStates[pathStep - 1] != key))
+    {
+        if (!planPath(core.getBoard(), shape) && !(think(core) && planPath(core.getBoard(), shape)))
+        {
+            hasTarget = false;
+            return INPUT_HARDDROP;
+        }
+        if (pathLength == 0)
+            return INPUT_NONE;
+    }
+    return path[pathStep++];
+}
@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define BUNDLE_MMAP
+#endif
+
+#ifndef TRACE_H
+#include "trace.hpp"
+#endif
+
+#define BUNDLE_H
+
+//Bundles start with these bytes followed by a version
+const char BUNDLE_MAGIC[4] = {'T', 'M', 'A', 'B'};
+const uint32_t BUNDLE_VERSION = 1;
+
+//Bundle looked for next to the game when no other is given
+const char DEFAULT_BUNDLE_PATH[] = "assets.bundle";
+
+//Longest logical name, including the terminator
+const int BUNDLE_NAME = 96;
+
+//Pixel data of every image starts on a multiple of this
+const int BUNDLE_ALIGN = 16;
+
+//Start of a bundle file
+struct BundleHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+    uint32_t reserved;
+};
+
+//Index entry of one image, the pixels are already in an SDL_PixelFormatEnum layout
+struct BundleEntry
+{
+    char name[BUNDLE_NAME];
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t pitch;
+    uint64_t offset;
+    uint64_t size;
+};
+
+//The file is written and read as raw structs, so their layout is part of the format
+static_assert(sizeof(BundleHeader) == 16, "BundleHeader layout changed");
+static_assert(sizeof(BundleEntry) == BUNDLE_NAME + 32, "BundleEntry layout changed");
+
+//A packed file of decoded images, mapped into memory so textures are created straight from it
+class AssetBundle
+{
+    public:
+        //Constructor
+        AssetBundle();
+
+        //Destructor
+        ~AssetBundle();
+
+        //Map a bundle, false if it is missing or damaged
+        bool open(std::string path);
+
+        //Unmap the bundle
+        void close();
+
+        //Check if a bundle is open
+        bool isOpen() const;
+
+        //Find an image by logical name, NULL if the bundle does not have it
+        const BundleEntry *find(std::string name) const;
+
+        //Get the pixels of an image
+        const uint8_t *getPixels(const BundleEntry *entry) const;
+
+        //Wrap the pixels of an image in a surface without copying, free it before closing the bundle
+        SDL_Surface *createSurface(const BundleEntry *entry) const;
+
+    private:
+        //Check the header and every entry against the file size
+        bool validate();
+
+        //Bundle bytes, mapped or read into fallback
+        const uint8_t *data;
+        size_t size;
+        bool mapped;
+        std::vector<uint8_t> fallback;
+
+        //Index inside data
+        const BundleEntry *entries;
+        uint32_t count;
+};
+
+AssetBundle::AssetBundle()
+{
+    data = NULL;
+    size = 0;
+    mapped = false;
+    entries = NULL;
+    count = 0;
+}
+
+AssetBundle::~AssetBundle()
+{
+    close();
+}
+
+bool AssetBundle::open(std::string path)
+{
+    TRACE_ZONE("AssetBundle::open");
+    close();
+
+#ifdef BUNDLE_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        void *view = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view != MAP_FAILED)
+        {
+            data = (const uint8_t *)view;
+            size = info.st_size;
+            mapped = true;
+        }
+    }
+    ::close(fd);
+#endif
+
+    //Read the whole file where mapping is unavailable
+    if (!mapped)
+    {
+        FILE *file = fopen(path.c_str(), "rb");
+        if (file == NULL)
+            return false;
+
+        uint8_t buffer[65536];
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+            fallback.insert(fallback.end(), buffer, buffer + read);
+        fclose(file);
+        data = fallback.empty() ? NULL : &fallback[0];
+        size = fallback.size();
+    }
+
+    if (!validate())
+    {
+        printf("%s is not a valid asset bundle!\n", path.c_str());
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool AssetBundle::validate()
+{
+    if (data == NULL || size < sizeof(BundleHeader))
+        return false;
+
+    const BundleHeader *header = (const BundleHeader *)data;
+    if (memcmp(header->magic, BUNDLE_MAGIC, sizeof(BUNDLE_MAGIC)) != 0 || header->version != BUNDLE_VERSION)
+        return false;
+    if (header->count > (size - sizeof(BundleHeader)) / sizeof(BundleEntry))
+        return false;
+
+    entries = (const BundleEntry *)(data + sizeof(BundleHeader));
+    count = header->count;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const BundleEntry &entry = entries[i];
+        if (memchr(entry.name, 0, BUNDLE_NAME) == NULL || entry.offset > size || entry.size > size - entry.offset)
+            return false;
+        if ((uint64_t)entry.pitch * entry.height > entry.size || entry.pitch < entry.width * SDL_BYTESPERPIXEL(entry.format))
+            return false;
+    }
+    return true;
+}
+
+void AssetBundle::close()
+{
+#ifdef BUNDLE_MMAP
+    if (mapped)
+        munmap((void *)data, size);
+#endif
+    std::vector<uint8_t>().swap(fallback);
+    data = NULL;
+    size = 0;
+    mapped = false;
+    entries = NULL;
+    count = 0;
+}
+
+bool AssetBundle::isOpen() const
+{
+    return data != NULL;
+}
+
+const BundleEntry *AssetBundle::find(std::string name) const
+{
+    //A dozen entries, a linear scan beats building a map
+    for (uint32_t i = 0; i < count; i++)
+        if (name == entries[i].name)
+            return &entries[i];
+    return NULL;
+}
+
+const uint8_t *AssetBundle::getPixels(const BundleEntry *entry) const
+{
+    return data + entry->offset;
+}
+
+SDL_Surface *AssetBundle::createSurface(const BundleEntry *entry) const
+{
+    //SDL only reads from the surface, the mapping itself stays read only
+    return SDL_CreateRGBSurfaceWithFormatFrom((void *)getPixels(entry), entry->width, entry->height, SDL_BITSPERPIXEL(entry->format),
+                                              entry->pitch, entry->format);
+}
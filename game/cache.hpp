@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <string>
+#include <map>
+
+#ifndef TEXTURE_H
+#include "texture.hpp"
+#endif
+
+#ifndef INIT_H
+#include "init.hpp"
+#endif
+
+#ifndef TRACE_H
+#include "trace.hpp"
+#endif
+
+#define CACHE_H
+
+//Block texture paths indexed by Colors
+const char *BLOCK_PATHS[COLOR_TOTAL] = {
+    "Assets/Textures/Blocks/Blue_Block.png",
+    "Assets/Textures/Blocks/Green_Block.png",
+    "Assets/Textures/Blocks/Purple_Block.png",
+    "Assets/Textures/Blocks/Pink_Block.png",
+    "Assets/Textures/Blocks/Red_Block.png",
+    "Assets/Textures/Blocks/Yellow_Block.png",
+    "Assets/Textures/Blocks/Teal_block.png"
+};
+
+//Owns every texture the game uses, each decoded exactly once
+//Block colors share one atlas texture so a whole board can be drawn in a single call
+class TextureCache
+{
+    public:
+        //Constructor
+        TextureCache();
+
+        //Destructor
+        ~TextureCache();
+
+        //Create the texture of a decoded image and free the surface, blocks go into the atlas once all of them arrived
+        bool upload(SDL_Renderer *gRenderer, std::string path, SDL_Surface *surface);
+
+        //Get the block atlas
+        LTexture *getAtlas();
+
+        //Get a view of one block in the atlas
+        TextureView getBlock(Colors color);
+
+        //Get the area of a block color inside the atlas
+        SDL_Rect getBlockClip(Colors color);
+
+        //Get a texture by path, decoding it on first use
+        LTexture *get(SDL_Renderer *gRenderer, std::string path);
+
+        //Free all textures
+        void free();
+
+    private:
+        //Copy the block surfaces side by side into the atlas
+        bool buildAtlas(SDL_Renderer *gRenderer);
+
+        //Free block surfaces still waiting for the atlas
+        void freeBlockSurfaces();
+
+        //Decoded blocks waiting for the atlas
+        SDL_Surface *blockSurfaces[COLOR_TOTAL];
+
+        //Block atlas, one block per color from left to right
+        LTexture atlas;
+
+        //Block dimensions
+        int blockWidth;
+        int blockHeight;
+
+        //UI textures keyed by path
+        std::map<std::string, LTexture> assets;
+};
+
+TextureCache::TextureCache()
+{
+    blockWidth = 0;
+    blockHeight = 0;
+    for (int i = 0; i < COLOR_TOTAL; i++)
+        blockSurfaces[i] = NULL;
+}
+
+TextureCache::~TextureCache()
+{
+    free();
+}
+
+bool TextureCache::upload(SDL_Renderer *gRenderer, std::string path, SDL_Surface *surface)
+{
+    TRACE_ZONE("TextureCache::upload");
+    if (surface == NULL)
+        return false;
+
+    //Blocks wait for each other, the atlas needs all of them
+    for (int i = 0; i < COLOR_TOTAL; i++)
+    {
+        if (path == BLOCK_PATHS[i])
+        {
+            if (blockSurfaces[i] != NULL)
+                SDL_FreeSurface(blockSurfaces[i]);
+            blockSurfaces[i] = surface;
+            for (int j = 0; j < COLOR_TOTAL; j++)
+                if (blockSurfaces[j] == NULL)
+                    return true;
+            return buildAtlas(gRenderer);
+        }
+    }
+
+    //Construct in place so the texture is never copied
+    LTexture &texture = assets[path];
+    bool success = texture.loadFromSurface(gRenderer, surface);
+    SDL_FreeSurface(surface);
+    if (!success)
+        assets.erase(path);
+    return success;
+}
+
+bool TextureCache::buildAtlas(SDL_Renderer *gRenderer)
+{
+    blockWidth = blockSurfaces[0]->w;
+    blockHeight = blockSurfaces[0]->h;
+
+    //Copy every block side by side, scaled to the size of the first one
+    bool success = false;
+    SDL_Surface *sheet = SDL_CreateRGBSurfaceWithFormat(0, blockWidth * COLOR_TOTAL, blockHeight, 32, SDL_PIXELFORMAT_RGBA32);
+    if (sheet == NULL)
+        printf("Unable to create block atlas! SDL Error: %s\n", SDL_GetError());
+    else
+    {
+        for (int i = 0; i < COLOR_TOTAL; i++)
+        {
+            SDL_Rect clip = getBlockClip(Colors(i));
+            SDL_SetSurfaceBlendMode(blockSurfaces[i], SDL_BLENDMODE_NONE);
+            SDL_BlitScaled(blockSurfaces[i], NULL, sheet, &clip);
+        }
+        success = atlas.loadFromSurface(gRenderer, sheet);
+        SDL_FreeSurface(sheet);
+    }
+
+    freeBlockSurfaces();
+    return success;
+}
+
+void TextureCache::freeBlockSurfaces()
+{
+    for (int i = 0; i < COLOR_TOTAL; i++)
+    {
+        if (blockSurfaces[i] != NULL)
+            SDL_FreeSurface(blockSurfaces[i]);
+        blockSurfaces[i] = NULL;
+    }
+}
+
+LTexture *TextureCache::getAtlas()
+{
+    return &atlas;
+}
+
+SDL_Rect TextureCache::getBlockClip(Colors color)
+{
+    SDL_Rect clip = { color * blockWidth, 0, blockWidth, blockHeight };
+    return clip;
+}
+
+TextureView TextureCache::getBlock(Colors color)
+{
+    SDL_Rect clip = getBlockClip(color);
+    return atlas.view(&clip);
+}
+
+LTexture *TextureCache::get(SDL_Renderer *gRenderer, std::string path)
+{
+    TRACE_ZONE("TextureCache::get");
+    std::map<std::string, LTexture>::iterator it = assets.find(path);
+    if (it != assets.end())
+        return &it->second;
+
+    //Construct in place so the texture is never copied
+    LTexture &texture = assets[path];
+    if (!texture.loadFromFile(gRenderer, path))
+    {
+        assets.erase(path);
+        return NULL;
+    }
+    return &texture;
+}
+
+void TextureCache::free()
+{
+    atlas.free();
+    freeBlockSurfaces();
+
+    for (auto &asset: assets)
+        asset.second.free();
+    assets.clear();
+}
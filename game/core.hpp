@@ -0,0 +1,305 @@
+#include <stdint.h>
+
+#ifndef DEFS_H
+#include "defs.hpp"
+#endif
+
+#ifndef BOARD_H
+#include "board.hpp"
+#endif
+
+#ifndef SHAPE_H
+#include "shape.hpp"
+#endif
+
+#ifndef RANDOM_H
+#include "random.hpp"
+#endif
+
+#ifndef TRACE_H
+#include "trace.hpp"
+#endif
+
+#define CORE_H
+
+//Actions consumed by a simulation step, combined as bit flags
+enum Input
+{
+    INPUT_NONE = 0,
+    INPUT_LEFT = 1 << 0,
+    INPUT_RIGHT = 1 << 1,
+    INPUT_DOWN = 1 << 2,
+    INPUT_ROTATE = 1 << 3,
+    INPUT_HARDDROP = 1 << 4
+};
+
+//Pseudo random inputs from their own xorshift so runs are reproducible, mostly idle steps with an occasional key like a player
+uint8_t noiseInputs(uint32_t &noise)
+{
+    noise ^= noise << 13;
+    noise ^= noise >> 17;
+    noise ^= noise << 5;
+    return (noise >> 24) < 32 ? (uint8_t)(noise & (INPUT_LEFT | INPUT_RIGHT | INPUT_DOWN | INPUT_ROTATE)) : (uint8_t)INPUT_NONE;
+}
+
+//Rate of the fixed simulation step
+const int STEP_RATE = 60;
+const double STEP_DT = 1.0 / STEP_RATE;
+
+//Lines to clear before the level goes up
+const int LINES_PER_LEVEL = 10;
+
+//Steps per gravity drop for each level, the last entry holds for every level above it
+const int GRAVITY_STEPS[] = {48, 43, 38, 33, 28, 23, 18, 13, 8, 6, 5, 5, 5, 4, 4, 4, 3, 3, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1};
+const int GRAVITY_LEVELS = sizeof(GRAVITY_STEPS) / sizeof(GRAVITY_STEPS[0]);
+
+//Slack so a sum of fixed steps reaches an interval that is a whole number of steps
+const double TIMER_EPSILON = 1e-9;
+
+//The whole game simulation, free of SDL so it can run without a window
+class GameCore
+{
+    public:
+        //Constructor
+        GameCore(uint32_t seed = 1);
+
+        //Start a new game
+        void reset(uint32_t seed);
+
+        //Apply inputs and advance the timers by dt seconds
+        void step(uint8_t inputs, double dt);
+
+        //Get the settled stack
+        const Board &getBoard() const;
+
+        //Get the falling shape
+        const Shape &getShape() const;
+
+        //Get an upcoming shape, 0 is the next one, up to BAG_LOOKAHEAD
+        Shapes peekShape(int i) const;
+
+        //Get the score
+        int getScore() const;
+
+        //Get the cleared lines
+        int getLines() const;
+
+        //Get the level, starting at 1
+        int getLevel() const;
+
+        //Get the seconds between gravity drops at the current level
+        double getGravityInterval() const;
+
+        //Get the rows removed by the last lock
+        LineClear getLastClear() const;
+
+        //Check if the stack reached the top
+        bool isOver() const;
+
+        //Get the number of shapes dealt so far
+        int getPieces() const;
+
+        //Append everything needed to resume the game from this step
+        void writeState(StateWriter &out) const;
+
+        //Restore a state written by writeState, false if it was truncated or holds a value out of range
+        bool readState(StateReader &in);
+
+    private:
+        //The benchmarks time the spawn on its own
+        friend class CoreBench;
+
+        //Create new shape
+        void createNewShape();
+
+        //Lock the shape if it settled and clear lines
+        void examineGrid();
+
+        //Game board
+        Board board;
+
+        //The current shape
+        Shape currentShape;
+
+        //Randomizer
+        ShapeBag bag;
+
+        //Time since the last gravity step
+        double gravityTimer;
+
+        //Score and cleared lines
+        int score;
+        int lines;
+
+        //Shapes dealt
+        int pieces;
+
+        //Rows removed by the last lock, for animation
+        LineClear lastClear;
+
+        //Flag to check if game over
+        bool over;
+};
+
+GameCore::GameCore(uint32_t seed)
+{
+    reset(seed);
+}
+
+void GameCore::reset(uint32_t seed)
+{
+    board.clear();
+    bag.reset(seed);
+    gravityTimer = 0;
+    score = 0;
+    lines = 0;
+    pieces = 0;
+    lastClear.count = 0;
+    lastClear.rows = 0;
+    over = false;
+    createNewShape();
+}
+
+void GameCore::createNewShape()
+{
+    currentShape = Shape(bag.next());
+    pieces++;
+    if (currentShape.checkBlocked(board))
+        over = true;
+}
+
+void GameCore::examineGrid()
+{
+    TRACE_ZONE("GameCore::examineGrid");
+    if (currentShape.checkSettled(board))
+    {
+        int x, y;
+        currentShape.getRelativePosition(x, y);
+        currentShape.lock(board);
+
+        //Only the rows under the shape box can have been completed
+        lastClear = board.clearLines(y, SHAPE_BOX);
+        lines += lastClear.count;
+        score += LINE_SCORES[lastClear.count];
+        createNewShape();
+    }
+}
+
+void GameCore::step(uint8_t inputs, double dt)
+{
+    TRACE_ZONE("GameCore::step");
+    if (over)
+        return;
+
+    if (inputs & INPUT_ROTATE)
+        currentShape.flipAngle(board);
+    if (inputs & INPUT_LEFT)
+        currentShape.moveLeft(board);
+    if (inputs & INPUT_RIGHT)
+        currentShape.moveRight(board);
+    if (inputs & INPUT_DOWN)
+    {
+        currentShape.moveDown(board);
+        gravityTimer = 0;
+    }
+    if (inputs & INPUT_HARDDROP)
+    {
+        currentShape.hardDrop(board);
+        gravityTimer = 0;
+    }
+
+    gravityTimer += dt;
+    double interval = getGravityInterval();
+    if (gravityTimer + TIMER_EPSILON >= interval)
+    {
+        gravityTimer -= interval;
+        currentShape.moveDown(board);
+    }
+
+    examineGrid();
+}
+
+const Board &GameCore::getBoard() const
+{
+    return board;
+}
+
+const Shape &GameCore::getShape() const
+{
+    return currentShape;
+}
+
+Shapes GameCore::peekShape(int i) const
+{
+    return bag.peek(i);
+}
+
+int GameCore::getScore() const
+{
+    return score;
+}
+
+int GameCore::getLines() const
+{
+    return lines;
+}
+
+int GameCore::getLevel() const
+{
+    return 1 + lines / LINES_PER_LEVEL;
+}
+
+double GameCore::getGravityInterval() const
+{
+    int index = getLevel() - 1;
+    if (index >= GRAVITY_LEVELS)
+        index = GRAVITY_LEVELS - 1;
+    return GRAVITY_STEPS[index] * STEP_DT;
+}
+
+LineClear GameCore::getLastClear() const
+{
+    return lastClear;
+}
+
+bool GameCore::isOver() const
+{
+    return over;
+}
+
+int GameCore::getPieces() const
+{
+    return pieces;
+}
+
+void GameCore::writeState(StateWriter &out) const
+{
+    board.writeState(out);
+    currentShape.writeState(out);
+    bag.writeState(out);
+    out.f64(gravityTimer);
+    out.u32(score);
+    out.u32(lines);
+    out.u32(pieces);
+    out.u8(lastClear.count);
+    out.u32(lastClear.rows);
+    out.u8(over);
+}
+
+bool GameCore::readState(StateReader &in)
+{
+    if (!board.readState(in) || !currentShape.readState(in) || !bag.readState(in))
+        return false;
+    gravityTimer = in.f64();
+    score = in.u32();
+    lines = in.u32();
+    pieces = in.u32();
+    lastClear.count = in.u8();
+    lastClear.rows = in.u32();
+    over = in.u8() != 0;
+
+    //A shape still in play never overlaps the stack
+    if (!over && currentShape.checkBlocked(board))
+        return false;
+    return in.ok();
+}
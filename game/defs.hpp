@@ -0,0 +1,32 @@
+#define DEFS_H
+
+enum Shapes
+{
+    S_SHAPE,
+    Z_SHAPE,
+    T_SHAPE,
+    L_SHAPE,
+    I_SHAPE,
+    ML_SHAPE,
+    SQR_SHAPE,
+    SHAPE_TOTAL
+};
+
+enum Colors
+{
+    BLUE,
+    GREEN,
+    PURPLE,
+    PINK,
+    RED,
+    YELLOW,
+    TEAL,
+    COLOR_TOTAL
+};
+
+//Grid dimension
+const int GRID_WIDTH = 15;
+const int GRID_HEIGHT = 30;
+
+//Points for clearing 0 to 4 lines with one shape
+const int LINE_SCORES[5] = {0, 100, 300, 500, 800};
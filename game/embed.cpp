@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+//Folders embedded when none are given
+const char *DEFAULT_EMBED_DIRS[] = {"Assets/Images", "Assets/Textures"};
+
+//Header the game includes when built with -DEMBED_ASSETS
+const char DEFAULT_EMBED_PATH[] = "game/embedded_assets.hpp";
+
+//Bytes written per line of an array
+const int EMBED_LINE_BYTES = 16;
+
+//Collect every PNG under a folder, named by its path the way the game asks for it
+void findAssets(std::string dir, std::vector<std::string> &paths)
+{
+    std::error_code error;
+    for (auto it = std::filesystem::recursive_directory_iterator(dir, error); !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+    {
+        std::string extension = it->path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        if (it->is_regular_file() && extension == ".png")
+            paths.push_back(it->path().generic_string());
+    }
+    if (error)
+        printf("Unable to read %s: %s\n", dir.c_str(), error.message().c_str());
+}
+
+//Write one asset as a constexpr array
+bool writeArray(FILE *out, int index, std::string path)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == NULL)
+    {
+        printf("Unable to read %s!\n", path.c_str());
+        return false;
+    }
+
+    fprintf(out, "//%s\nconstexpr unsigned char EMBEDDED_%d[] = {", path.c_str(), index);
+    unsigned char buffer[4096];
+    size_t read, total = 0;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        for (size_t i = 0; i < read; i++, total++)
+            fprintf(out, "%s0x%02x,", total % EMBED_LINE_BYTES == 0 ? "\n    " : " ", buffer[i]);
+    fclose(file);
+    fprintf(out, "\n};\n\n");
+    return total > 0;
+}
+
+int main(int argc, char *args[])
+{
+    std::string outPath = DEFAULT_EMBED_PATH;
+    std::vector<std::string> dirs;
+
+    //Command line options, anything else is a folder to embed
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(args[i], "--out") == 0 && i + 1 < argc)
+            outPath = args[++i];
+        else if (args[i][0] == '-')
+        {
+            printf("Usage: %s [--out FILE] [FOLDER...]\n", args[0]);
+            return 1;
+        }
+        else
+            dirs.push_back(args[i]);
+    }
+    if (dirs.empty())
+        dirs.assign(DEFAULT_EMBED_DIRS, DEFAULT_EMBED_DIRS + sizeof(DEFAULT_EMBED_DIRS) / sizeof(DEFAULT_EMBED_DIRS[0]));
+
+    std::vector<std::string> paths;
+    for (std::string &dir: dirs)
+        findAssets(dir, paths);
+    std::sort(paths.begin(), paths.end());
+
+    FILE *out = fopen(outPath.c_str(), "w");
+    if (out == NULL)
+    {
+        printf("Unable to write %s!\n", outPath.c_str());
+        return 1;
+    }
+
+    fprintf(out, "//Generated by tetris_embed from the files under Assets, do not edit\n\n#define EMBEDDED_ASSETS_H\n\n");
+    bool success = true;
+    for (size_t i = 0; i < paths.size(); i++)
+        success = writeArray(out, i, paths[i]) && success;
+
+    //The table always has an entry so it is a valid array even with nothing embedded
+    fprintf(out, "const EmbeddedAsset EMBEDDED_ASSETS[] = {\n");
+    for (size_t i = 0; i < paths.size(); i++)
+        fprintf(out, "    {\"%s\", EMBEDDED_%zu, sizeof(EMBEDDED_%zu)},\n", paths[i].c_str(), i, i);
+    fprintf(out, "    {NULL, NULL, 0}\n};\n\nconst int EMBEDDED_ASSET_COUNT = %zu;\n", paths.size());
+
+    if (fclose(out) != 0 || !success)
+    {
+        printf("Unable to embed every asset!\n");
+        return 1;
+    }
+    printf("Embedded %zu assets into %s\n", paths.size(), outPath.c_str());
+    return 0;
+}
@@ -1,9 +1,20 @@
 #include <stdio.h>
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
+#include <ctime>
 #include "ui.hpp"
-#include <vector>
-#include "shape.hpp"
+
+#ifndef BATCH_H
+#include "batch.hpp"
+#endif
+
+#ifndef CORE_H
+#include "core.hpp"
+#endif
+
+#ifndef REPLAY_H
+#include "replay.hpp"
+#endif
 
 #ifndef TEXTURE_H
 #include "texture.hpp"
@@ -13,6 +24,26 @@
 #include "init.hpp"
 #endif
 
+#ifndef CACHE_H
+#include "cache.hpp"
+#endif
+
+#ifndef TRACE_H
+#include "trace.hpp"
+#endif
+
+#ifndef OVERLAY_H
+#include "overlay.hpp"
+#endif
+
+#ifndef LOADER_H
+#include "loader.hpp"
+#endif
+
+#ifndef BOT_H
+#include "bot.hpp"
+#endif
+
 class Game 
 {
     public:
@@ -34,16 +65,37 @@ class Game
         //Set Position
         void setTexturePositions();
 
-    private:
-        //Create new shape
-        void createNewShape();
+        //Set the seed of the first game, later games count up from it
+        void setSeed(Uint32 seed);
 
+        //Set where finished games are recorded, empty to not save them
+        void setRecordPath(std::string path);
+
+        //Play a recorded game instead of reading the keyboard
+        bool loadReplay(std::string path);
+
+        //Set the playback speed multiplier, 0 or less runs uncapped
+        void setPlaybackSpeed(double speed);
+
+        //Set the performance counter value at launch, time to first frame is reported from it
+        void setLaunchTime(Uint64 counter);
+
+        //Let the bot play instead of the keyboard
+        void setBot(bool enabled);
+
+    private:
         //Render the game area background
         void renderGameAreaBackground();
 
+        //Render the loading bar
+        void renderSplash(int done, int total);
+
         //Render Static Textures
         void renderStaticTextures();
 
+        //Composite the images and buttons into the static layer
+        bool buildStaticLayer();
+
         //Render dynamic textures
         void renderDynamicTextures();
 
@@ -53,12 +105,33 @@ class Game
         //Render the Buttons
         void renderButtons();
 
-        //Render current shape
+        //Queue the current shape
         void renderCurrentShape();
 
-        //Render the blocks
+        //Queue the landing preview of the current shape
+        void renderGhost();
+
+        //Recompute the landing row if the shape moved sideways, rotated or was replaced
+        void updateGhost();
+
+        //Queue the settled blocks
         void renderBlocks();
 
+        //Queue the upcoming shapes
+        void renderPreview();
+
+        //Queue one block of the grid
+        void queueCell(int x, int y, Colors color, Uint8 alpha = 0xFF);
+
+        //Queue one block at a screen position
+        void queueBlock(int x, int y, Colors color, Uint8 alpha = 0xFF);
+
+        //Handle one event
+        void handleEvent();
+
+        //Handle window state changes
+        void handleWindowEvent();
+
         //Handle mouse input
         void handleMouseInput();
 
@@ -77,8 +150,32 @@ class Game
         //Set button positions
         void setButtonPositions();
 
-        //Examine the grid
-        void examineGrid();
+        //Check if the loop should sleep until the next event
+        bool isIdle();
+
+        //Render a frame
+        void render();
+
+        //Run as many fixed simulation steps as the elapsed time allows
+        void update(double elapsed);
+
+        //Run one simulation step on the player or replay inputs
+        void stepCore();
+
+        //Save the recording and go back to the menu with a fresh game
+        void endGame();
+
+        //Jump the replay being watched to a step
+        void seekReplay(int step);
+
+        //Choose the frame rate cap when vsync is unavailable
+        void setupFrameLimit();
+
+        //Sleep off the rest of the frame when vsync is unavailable
+        void limitFrameRate(Uint64 frameStart);
+
+        //Add the counter ticks since start to a section of the overlay, returns now
+        Uint64 timeSection(FrameSection section, Uint64 start);
 
         //Screen dimensions
         int SCREEN_WIDTH;
@@ -93,8 +190,11 @@ class Game
         //Renderer
         SDL_Renderer *gRenderer;
 
-        //Image Textures
-        LTexture images[IMAGE_TOTAL];
+        //Decoded textures
+        TextureCache cache;
+
+        //Image Textures, owned by the cache
+        LTexture *images[IMAGE_TOTAL];
 
         //Game Phase
         GamePhase phase;
@@ -102,20 +202,80 @@ class Game
         //Buttons
         LButton buttons[BUTTON_TOTAL];
 
-        //Game grid
-        int grid[GRID_HEIGHT][GRID_WIDTH];
-
         //Origin coord
         int org_x, org_y;
 
-        //Textures to render
-        std::vector<Block> renderQueue;
-
         //SDL_Event
         SDL_Event e;
 
-        //The current shape
-        Shape currentShape = NULL;
+        //Game simulation
+        GameCore core;
+
+        //Blocks of the board and the shape, drawn in one call
+        BlockBatch batch;
+
+        //Landing row of the current shape
+        int ghostY;
+
+        //Column, orientation and piece number the landing row was computed for, ghostPiece is -1 when stale
+        int ghostX;
+        int ghostRotation;
+        int ghostPiece;
+
+        //Seed of the current game
+        Uint32 seed;
+
+        //Recording of the current game, or the game being played back
+        Replay replay;
+
+        //Flag set while the replay drives the simulation
+        bool playingBack;
+
+        //Playback speed multiplier
+        double playbackSpeed;
+
+        //Where finished games are recorded
+        std::string recordPath;
+
+        //Inputs gathered since the last step
+        Uint8 inputs;
+
+        //Simulation time not yet stepped
+        double accumulator;
+
+        //Performance counter ticks per second
+        Uint64 counterFrequency;
+
+        //Shortest frame in counter ticks, 0 when vsync paces the frames
+        Uint64 minFrameTicks;
+
+        //Window state, nothing is drawn while hidden or unfocused
+        bool visible;
+        bool focused;
+
+        //Flag set when an idle screen needs to be drawn again
+        bool redraw;
+
+        //Images and buttons composited once, drawn with a single copy
+        SDL_Texture *staticLayer;
+
+        //Flag set when layout or assets changed since the layer was built
+        bool staticDirty;
+
+        //Frame timing overlay
+        Overlay overlay;
+
+        //Background image decoding
+        AssetLoader loader;
+
+        //Performance counter value at launch
+        Uint64 launchCounter;
+
+        //Computer player, created the first time it is switched on
+        Bot *bot;
+
+        //Flag set while the bot drives the simulation
+        bool botPlaying;
 };
 
 Game::Game(int SCREEN_WIDTH, int SCREEN_HEIGHT, SDL_Window *gWindow, SDL_Renderer *gRenderer)
@@ -125,9 +285,29 @@ Game::Game(int SCREEN_WIDTH, int SCREEN_HEIGHT, SDL_Window *gWindow, SDL_Rendere
     this->gWindow = gWindow;
     this->gRenderer = gRenderer;
     this->Gameover = false;
-    for (int i = 0; i < 25; i++)
-        for (int j = 0; j < 25; j++)
-            grid[i][j] = 0;
+    this->inputs = INPUT_NONE;
+    this->accumulator = 0;
+    this->counterFrequency = SDL_GetPerformanceFrequency();
+    this->minFrameTicks = 0;
+    this->visible = true;
+    this->focused = true;
+    this->redraw = true;
+    this->staticLayer = NULL;
+    this->staticDirty = true;
+    this->seed = (Uint32)time(NULL);
+    this->playingBack = false;
+    this->playbackSpeed = 1;
+    this->recordPath = DEFAULT_REPLAY_PATH;
+    this->ghostY = 0;
+    this->ghostX = 0;
+    this->ghostRotation = 0;
+    this->ghostPiece = -1;
+    this->launchCounter = SDL_GetPerformanceCounter();
+    this->bot = NULL;
+    this->botPlaying = false;
+    batch.reserve(GRID_WIDTH * GRID_HEIGHT + 4 * (PREVIEW_SHAPES + 2));
+    for (int i = 0; i < IMAGE_TOTAL; i++)
+        images[i] = NULL;
 }
 
 Game::~Game()
@@ -137,6 +317,50 @@ Game::~Game()
 
 bool Game::loadAssets()
 {
+    TRACE_ZONE("Game::loadAssets");
+    staticDirty = true;
+
+    //Every image decodes on the loader threads while the splash is up
+    std::vector<std::string> names(BLOCK_PATHS, BLOCK_PATHS + COLOR_TOTAL);
+    for (int i = 0; i < IMAGE_TOTAL; i++)
+        if (IMAGE_PATHS[i] != NULL)
+            names.push_back(IMAGE_PATHS[i]);
+    for (int i = 0; i < BUTTON_TOTAL; i++)
+        names.push_back(BUTTON_PATHS[i]);
+    loader.start(names);
+
+    bool success = true;
+    bool firstFrame = true;
+    while (!loader.isFinished() && !Gameover)
+    {
+        Uint64 frameStart = SDL_GetPerformanceCounter();
+        while (SDL_PollEvent(&e) != 0)
+            if (e.type == SDL_QUIT)
+                Gameover = true;
+
+        //Textures are created here, on the render thread
+        DecodedAsset asset;
+        while (loader.next(asset))
+            if (!cache.upload(gRenderer, loader.getName(asset.index), asset.surface))
+                success = false;
+
+        renderSplash(loader.getDone(), loader.getTotal());
+        if (firstFrame)
+        {
+            printf("First frame after %.1f ms\n", (SDL_GetPerformanceCounter() - launchCounter) * 1000.0 / counterFrequency);
+            firstFrame = false;
+        }
+        limitFrameRate(frameStart);
+    }
+    loader.stop();
+    if (Gameover)
+        return false;
+
+    printf("Assets ready after %.1f ms, %d images on %d threads\n", (SDL_GetPerformanceCounter() - launchCounter) * 1000.0 / counterFrequency,
+           loader.getTotal(), loader.getThreads());
+
+    //Everything is cached now, so these only look the textures up
+    if (!success) return false;
     if (!loadImages()) return false;
     if (!loadButtons()) return false;
     return true;
@@ -144,15 +368,20 @@ bool Game::loadAssets()
 
 bool Game::loadImages()
 {
-    if (!images[GAMEAREABACKGROUND].loadFromFile(gRenderer, "Assets/Images/gameAreaBackground.png")) return false;
-    if (!images[LOGO].loadFromFile(gRenderer, "Assets/Images/Logo.png")) return false;
+    for (int i = 0; i < IMAGE_TOTAL; i++)
+    {
+        if (IMAGE_PATHS[i] == NULL)
+            continue;
+        images[i] = cache.get(gRenderer, IMAGE_PATHS[i]);
+        if (images[i] == NULL) return false;
+    }
     return true;
 }
 
 bool Game::loadButtons()
 {
-    if (!buttons[START_BUTTON].loadFromFile(gRenderer, "Assets/Textures/UI/start_button.png")) return false;
-    if (!buttons[STOP_BUTTON].loadFromFile(gRenderer, "Assets/Textures/UI/quit_button.png")) return false;
+    for (int i = 0; i < BUTTON_TOTAL; i++)
+        if (!buttons[i].loadFromFile(gRenderer, cache, BUTTON_PATHS[i])) return false;
     return true;
 }
 
@@ -160,13 +389,14 @@ void Game::setTexturePositions()
 {
     setImagePositions();
     setButtonPositions();
+    staticDirty = true;
 }
 
 void Game::setImagePositions()
 {
-    images[GAMEAREABACKGROUND].setPosition(SCREEN_WIDTH - images[GAMEAREABACKGROUND].getWidth() - 75, 35);
-    images[LOGO].setPosition(100, 35);
-    images[GAMEAREABACKGROUND].getPosition(org_x, org_y);
+    images[GAMEAREABACKGROUND]->setPosition(SCREEN_WIDTH - images[GAMEAREABACKGROUND]->getWidth() - 75, 35);
+    images[LOGO]->setPosition(100, 35);
+    images[GAMEAREABACKGROUND]->getPosition(org_x, org_y);
     org_x += 12;
     org_y += 12;
 }
@@ -175,18 +405,66 @@ void Game::setButtonPositions()
 {
     buttons[START_BUTTON].setPosition(200, 300);
     buttons[STOP_BUTTON].setPosition(200, 400);
+    buttons[PAUSE_BUTTON].setPosition(200, 500);
+}
+
+void Game::renderSplash(int done, int total)
+{
+    SDL_SetRenderDrawColor( gRenderer, 0x00, 0x00, 0x00, 0xFF );
+    SDL_RenderClear( gRenderer );
+
+    SDL_Rect frame = { (SCREEN_WIDTH - SPLASH_WIDTH) / 2, (SCREEN_HEIGHT - SPLASH_HEIGHT) / 2, SPLASH_WIDTH, SPLASH_HEIGHT };
+    SDL_Rect fill = { frame.x + 4, frame.y + 4, total > 0 ? (SPLASH_WIDTH - 8) * done / total : 0, SPLASH_HEIGHT - 8 };
+    SDL_SetRenderDrawColor( gRenderer, 0xFF, 0xFF, 0xFF, 0xFF );
+    SDL_RenderDrawRect( gRenderer, &frame );
+    SDL_RenderFillRect( gRenderer, &fill );
+    SDL_RenderPresent( gRenderer );
 }
 
 void Game::renderStaticTextures()
 {
+    TRACE_ZONE("Game::renderStaticTextures");
+    if (staticDirty && !buildStaticLayer())
+    {
+        //Render targets are unavailable, draw everything directly
+        renderImages();
+        renderButtons();
+        return;
+    }
+    SDL_RenderCopy(gRenderer, staticLayer, NULL, NULL);
+}
+
+bool Game::buildStaticLayer()
+{
+    TRACE_ZONE("Game::buildStaticLayer");
+    if (!SDL_RenderTargetSupported(gRenderer))
+        return false;
+
+    if (staticLayer == NULL)
+    {
+        staticLayer = SDL_CreateTexture(gRenderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, SCREEN_WIDTH, SCREEN_HEIGHT);
+        if (staticLayer == NULL)
+        {
+            printf("Unable to create static layer! SDL Error: %s\n", SDL_GetError());
+            return false;
+        }
+    }
+
+    SDL_SetRenderTarget(gRenderer, staticLayer);
+    SDL_SetRenderDrawColor( gRenderer, 0x00, 0x00, 0x00, 0xFF );
+    SDL_RenderClear( gRenderer );
     renderImages();
     renderButtons();
+    SDL_SetRenderTarget(gRenderer, NULL);
+    staticDirty = false;
+    return true;
 }
 
 void Game::renderImages()
 {
     for (int i = 0; i < IMAGE_TOTAL; i++)
-        images[i].render(gRenderer);
+        if (images[i] != NULL)
+            images[i]->render(gRenderer);
 }
 
 void Game::renderButtons()
@@ -197,20 +475,167 @@ void Game::renderButtons()
 
 void Game::renderDynamicTextures()
 {
-    renderCurrentShape();
+    TRACE_ZONE("Game::renderDynamicTextures");
+    batch.clear();
     renderBlocks();
+    renderGhost();
+    renderCurrentShape();
+    renderPreview();
+
+    LTexture *atlas = cache.getAtlas();
+    batch.draw(gRenderer, atlas->getTexture(), atlas->getWidth(), atlas->getHeight());
 }
 
 void Game::renderCurrentShape()
 {
-    currentShape.render(gRenderer, org_x, org_y);
+    const Shape &shape = core.getShape();
+    const Orientation &o = shape.getOrientation();
+    int x, y;
+    shape.getRelativePosition(x, y);
+    for (int i = 0; i < 4; i++)
+    {
+        //Blocks above the grid are hidden
+        if (y + o.cells[i].y >= 0)
+            queueCell(x + o.cells[i].x, y + o.cells[i].y, shape.getColor());
+    }
+}
+
+void Game::updateGhost()
+{
+    const Shape &shape = core.getShape();
+    int x, y;
+    shape.getRelativePosition(x, y);
+
+    //Falling never changes where the shape lands, only moving sideways or rotating does
+    if (ghostPiece == core.getPieces() && ghostX == x && ghostRotation == shape.getRotation())
+        return;
+
+    ghostX = x;
+    ghostRotation = shape.getRotation();
+    ghostPiece = core.getPieces();
+    ghostY = y + shape.dropDistance(core.getBoard());
+}
+
+void Game::renderGhost()
+{
+    updateGhost();
+    const Shape &shape = core.getShape();
+    const Orientation &o = shape.getOrientation();
+    for (int i = 0; i < 4; i++)
+    {
+        if (ghostY + o.cells[i].y >= 0)
+            queueCell(ghostX + o.cells[i].x, ghostY + o.cells[i].y, shape.getColor(), GHOST_ALPHA);
+    }
 }
 
 void Game::renderBlocks()
 {
-    for (auto block: renderQueue)
+    TRACE_ZONE("Game::renderBlocks");
+    const Board &board = core.getBoard();
+    for (int y = 0; y < GRID_HEIGHT; y++)
+    {
+        //Walk only the filled cells of the row mask
+        uint32_t row = board.getRow(y);
+        while (row)
+        {
+            int x = __builtin_ctz(row);
+            queueCell(x, y, Colors(board.getColor(x, y)));
+            row &= row - 1;
+        }
+    }
+}
+
+void Game::renderPreview()
+{
+    for (int i = 0; i < PREVIEW_SHAPES; i++)
     {
-        block.render(gRenderer, org_x, org_y);
+        Shapes type = core.peekShape(i);
+        TextureView block = cache.getBlock(Colors(type));
+        const Orientation &o = getOrientation(type, 0);
+        for (int j = 0; j < 4; j++)
+            queueBlock(PREVIEW_X + o.cells[j].x * block.clip.w, PREVIEW_Y + i * PREVIEW_SPACING + o.cells[j].y * block.clip.h, Colors(type));
+    }
+}
+
+void Game::queueCell(int x, int y, Colors color, Uint8 alpha)
+{
+    TextureView block = cache.getBlock(color);
+    queueBlock(org_x + x * block.clip.w, org_y + y * block.clip.h, color, alpha);
+}
+
+void Game::queueBlock(int x, int y, Colors color, Uint8 alpha)
+{
+    TextureView block = cache.getBlock(color);
+    SDL_Rect dst = { x, y, block.clip.w, block.clip.h };
+    batch.add(block.clip, dst, alpha);
+}
+
+void Game::handleEvent()
+{
+    if (e.type == SDL_QUIT)
+        Gameover = true;
+
+    else if (e.type == SDL_WINDOWEVENT)
+    {
+        handleWindowEvent();
+    }
+
+    //Target textures lose their contents when the device is reset
+    else if (e.type == SDL_RENDER_TARGETS_RESET || e.type == SDL_RENDER_DEVICE_RESET)
+    {
+        staticDirty = true;
+        redraw = true;
+    }
+
+    else if (e.type == SDL_MOUSEBUTTONDOWN)
+    {
+        handleMouseInput();
+        redraw = true;
+    }
+
+    else if (e.type == SDL_KEYDOWN)
+    {
+        handleKeyboardInput();
+        redraw = true;
+    }
+}
+
+void Game::handleWindowEvent()
+{
+    switch(e.window.event)
+    {
+        case SDL_WINDOWEVENT_SHOWN:
+        case SDL_WINDOWEVENT_RESTORED:
+        visible = true;
+        redraw = true;
+        break;
+
+        case SDL_WINDOWEVENT_HIDDEN:
+        case SDL_WINDOWEVENT_MINIMIZED:
+        visible = false;
+        if (phase == ONGOING)
+            phase = PAUSED;
+        break;
+
+        case SDL_WINDOWEVENT_FOCUS_GAINED:
+        focused = true;
+        redraw = true;
+        break;
+
+        case SDL_WINDOWEVENT_FOCUS_LOST:
+        focused = false;
+        if (phase == ONGOING)
+            phase = PAUSED;
+        break;
+
+        case SDL_WINDOWEVENT_EXPOSED:
+        redraw = true;
+        break;
+
+        case SDL_WINDOWEVENT_SIZE_CHANGED:
+        staticDirty = true;
+        redraw = true;
+        break;
     }
 }
 
@@ -221,98 +646,365 @@ void Game::handleMouseInput()
     
     if (buttons[STOP_BUTTON].handleEvent(&e))
         Gameover = true;
+
+    if (buttons[PAUSE_BUTTON].handleEvent(&e))
+    {
+        if (phase == ONGOING)
+            phase = PAUSED;
+        else if (phase == PAUSED)
+            phase = ONGOING;
+    }
 }
 
 void Game::handleKeyboardInput()
 {
     switch(e.key.keysym.sym)
     {
+        case SDLK_ESCAPE:
+        case SDLK_p:
+        if (phase == ONGOING)
+            phase = PAUSED;
+        else if (phase == PAUSED)
+            phase = ONGOING;
+        break;
+
         case SDLK_DOWN:
-        currentShape.moveDown();
+        inputs |= INPUT_DOWN;
         break;
 
         case SDLK_LEFT:
-        currentShape.moveLeft();
+        inputs |= INPUT_LEFT;
         break;
 
         case SDLK_RIGHT:
-        currentShape.moveRight();
+        inputs |= INPUT_RIGHT;
         break;
 
         case SDLK_SPACE:
-        currentShape.flipAngle();
+        inputs |= INPUT_ROTATE;
+        break;
+
+        case SDLK_UP:
+        inputs |= INPUT_HARDDROP;
         break;
+
+        case SDLK_F3:
+        overlay.toggle();
+        break;
+
+        case SDLK_b:
+        if (!playingBack)
+            setBot(!botPlaying);
+        break;
+
+        case SDLK_PAGEUP:
+        case SDLK_PAGEDOWN:
+        if (playingBack)
+        {
+            int offset = SEEK_SECONDS * STEP_RATE;
+            if (e.key.keysym.sym == SDLK_PAGEUP)
+                offset = -offset;
+            seekReplay((int)replay.getPlayStep() + offset);
+        }
+        break;
+    }
+
+}
+
+void Game::update(double elapsed)
+{
+    TRACE_ZONE("Game::update");
+    if (phase != ONGOING)
+    {
+        accumulator = 0;
+        inputs = INPUT_NONE;
+        return;
+    }
+
+    if (elapsed > MAX_FRAME_TIME)
+        elapsed = MAX_FRAME_TIME;
+
+    //Recording room for the longest frame is made first, steady state steps must not touch the heap
+    if (!playingBack)
+        replay.reserveAhead((uint32_t)(MAX_FRAME_TIME * STEP_RATE) + 1);
+    AllocScope strict("Game::update");
+
+    //Uncapped playback runs as many steps as fit in one display frame
+    if (playingBack && playbackSpeed <= 0)
+    {
+        Uint64 start = SDL_GetPerformanceCounter();
+        while (phase == ONGOING && SDL_GetPerformanceCounter() - start < counterFrequency / STEP_RATE)
+            stepCore();
+        return;
+    }
+
+    accumulator += playingBack ? elapsed * playbackSpeed : elapsed;
+    while (phase == ONGOING && accumulator >= STEP_DT)
+    {
+        stepCore();
+        accumulator -= STEP_DT;
+    }
+}
+
+void Game::stepCore()
+{
+    TRACE_ZONE("Game::stepCore");
+    //Inputs are consumed by the first step that runs after them
+    Uint8 stepInputs = inputs;
+    inputs = INPUT_NONE;
+    if (playingBack)
+        stepInputs = replay.next();
+    else
+    {
+        if (botPlaying)
+            stepInputs = bot->next(core);
+        replay.record(stepInputs);
+    }
+
+    core.step(stepInputs, STEP_DT);
+    if (!playingBack)
+        replay.checkpoint(core);
+
+    //Back to the menu with a fresh game once the stack tops out
+    if (core.isOver() || (playingBack && replay.done()))
+        endGame();
+}
+
+void Game::endGame()
+{
+    TRACE_ZONE("Game::endGame");
+
+    //Saving the recording and starting over are allowed to allocate
+    AllocScope permit(NULL);
+    if (!playingBack)
+    {
+        replay.finish();
+        if (!recordPath.empty())
+            replay.save(recordPath);
     }
+    if (bot != NULL && bot->getPieces() > 0)
+        printf("Bot: %d shapes, %.3f ms mean and %.3f ms longest think on %d threads\n", bot->getPieces(),
+               bot->getThinkSeconds() * 1000 / bot->getPieces(), bot->getMaxThinkSeconds() * 1000, bot->getThreads());
 
+    playingBack = false;
+    phase = START;
+    core.reset(++seed);
+    ghostPiece = -1;
+    replay.begin(seed);
+    accumulator = 0;
+    redraw = true;
+}
+
+void Game::setupFrameLimit()
+{
+    SDL_RendererInfo info;
+    if (SDL_GetRendererInfo(gRenderer, &info) == 0 && (info.flags & SDL_RENDERER_PRESENTVSYNC))
+    {
+        minFrameTicks = 0;
+        return;
+    }
+
+    //Without vsync present returns immediately, so pace frames at the display rate
+    int rate = FALLBACK_FRAME_RATE;
+    SDL_DisplayMode mode;
+    if (SDL_GetWindowDisplayMode(gWindow, &mode) == 0 && mode.refresh_rate > 0)
+        rate = mode.refresh_rate;
+    minFrameTicks = counterFrequency / rate;
+}
+
+void Game::limitFrameRate(Uint64 frameStart)
+{
+    if (minFrameTicks == 0)
+        return;
+
+    Uint64 spent = SDL_GetPerformanceCounter() - frameStart;
+    if (spent < minFrameTicks)
+        SDL_Delay((Uint32)((minFrameTicks - spent) * 1000 / counterFrequency));
+}
+
+void Game::setSeed(Uint32 seed)
+{
+    this->seed = seed;
 }
 
-void Game::createNewShape()
+void Game::setRecordPath(std::string path)
 {
-    currentShape = Shape(gRenderer);
-    currentShape.setRelativePosition(7, 2);
-    currentShape.loadFromFile(gRenderer);
+    recordPath = path;
 }
 
-void Game::examineGrid()
+bool Game::loadReplay(std::string path)
 {
-    if(currentShape.checkSettled(grid))
+    if (!replay.load(path))
+        return false;
+
+    playingBack = true;
+    seed = replay.getSeed();
+    return true;
+}
+
+void Game::setPlaybackSpeed(double speed)
+{
+    playbackSpeed = speed;
+}
+
+void Game::setLaunchTime(Uint64 counter)
+{
+    launchCounter = counter;
+}
+
+void Game::setBot(bool enabled)
+{
+    //The search buffers are sized once here, never while stepping
+    //It thinks inside the fixed step, so it gets half a step and the frame still renders on time
+    if (enabled && bot == NULL)
+        bot = new Bot(0, BOT_BEAM, BOT_DEPTH, STEP_DT / 2);
+    botPlaying = enabled;
+    inputs = INPUT_NONE;
+}
+
+void Game::seekReplay(int step)
+{
+    TRACE_ZONE("Game::seekReplay");
+    if (step < 0)
+        step = 0;
+    replay.seek(core, step);
+    ghostPiece = -1;
+    accumulator = 0;
+    redraw = true;
+
+    if (core.isOver() || replay.done())
+        endGame();
+}
+
+bool Game::isIdle()
+{
+    return phase != ONGOING || !visible || !focused;
+}
+
+Uint64 Game::timeSection(FrameSection section, Uint64 start)
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    overlay.addSection(section, now - start);
+    return now;
+}
+
+void Game::render()
+{
+    TRACE_ZONE("Game::render");
+    AllocScope strict(phase == ONGOING ? "Game::render" : NULL);
+    Uint64 start = SDL_GetPerformanceCounter();
+    SDL_SetRenderDrawColor( gRenderer, 0x00, 0x00, 0x00, 0xFF );
+    SDL_RenderClear( gRenderer );
+    renderStaticTextures();
+    start = timeSection(SECTION_STATIC, start);
+    if (phase != START)
+    {
+        renderDynamicTextures();
+        start = timeSection(SECTION_DYNAMIC, start);
+    }
+    overlay.render(gRenderer);
+    start = SDL_GetPerformanceCounter();
     {
-        currentShape.purgeBlocks(renderQueue);
-        printf("%d\n", renderQueue.size());
-        createNewShape();
+        TRACE_ZONE("present");
+        SDL_RenderPresent( gRenderer );
     }
+    timeSection(SECTION_PRESENT, start);
 }
 
 bool Game::startGame()
 {
-    loadAssets();
+    TRACE_ZONE("Game::startGame");
+    setupFrameLimit();
+    if (!loadAssets())
+        return false;
     setTexturePositions();
     phase = START;
-    createNewShape();
+    core.reset(seed);
+    ghostPiece = -1;
+    if (playingBack)
+        phase = ONGOING;
+    else
+        replay.begin(seed);
+    Uint64 previous = SDL_GetPerformanceCounter();
     while (!Gameover)
     {
-        while (SDL_PollEvent(&e) != 0)
+        TRACE_ZONE("frame");
+        Uint64 frameStart = SDL_GetPerformanceCounter();
+        bool idle = isIdle();
+
+        //Menus and pause sleep until something happens instead of spinning
+        if (idle && !(redraw && visible && focused))
         {
-            if (e.type == SDL_QUIT)
-                Gameover = true;
-            
-            else if (e.type == SDL_MOUSEBUTTONDOWN)
-            {
-                handleMouseInput();
-            }
-
-            else if (e.type == SDL_KEYDOWN)
-            {
-                handleKeyboardInput();
-            }
-            examineGrid();
+            if (SDL_WaitEventTimeout(&e, IDLE_WAIT_MS))
+                handleEvent();
         }
-        examineGrid();
-        SDL_SetRenderDrawColor( gRenderer, 0x00, 0x00, 0x00, 0xFF );
-        SDL_RenderClear( gRenderer );
-        if (phase == START)
+
+        //Time spent waiting for an event is not part of the frame
+        Uint64 inputStart = SDL_GetPerformanceCounter();
+        AllocStats frameAllocs = allocSnapshot();
+        overlay.beginFrame();
         {
-            renderStaticTextures();
+            TRACE_ZONE("events");
+            while (SDL_PollEvent(&e) != 0)
+                handleEvent();
         }
-        else
+
+        //Time spent idle does not count towards the simulation
+        Uint64 now = timeSection(SECTION_INPUT, inputStart);
+        if (idle)
+            previous = now;
+        update((double)(now - previous) / counterFrequency);
+        previous = now;
+        timeSection(SECTION_UPDATE, now);
+
+        if (!visible || !focused)
+            continue;
+
+        if (!isIdle() || redraw || overlay.isVisible())
         {
-            renderStaticTextures();
-            renderDynamicTextures();
+            render();
+            redraw = false;
+            limitFrameRate(frameStart);
+            overlay.endFrame(SDL_GetPerformanceCounter() - inputStart, allocSince(frameAllocs));
         }
-        SDL_RenderPresent( gRenderer );
     }
-    
+
+    //Keep the recording of a game left unfinished
+    if ((phase == ONGOING || phase == PAUSED) && !playingBack)
+    {
+        replay.finish();
+        if (!recordPath.empty())
+            replay.save(recordPath);
+    }
+    return true;
 }
 
 void Game::free() 
 {
     //Free Textures
     for (int i = 0; i < IMAGE_TOTAL; i++)
-        images[i].free();
+        images[i] = NULL;
     
     for (int i = 0; i < BUTTON_TOTAL; i++)
         buttons[i].free();
 
+    loader.stop();
+    cache.free();
+
+    if (bot != NULL)
+    {
+        delete bot;
+        bot = NULL;
+    }
+    botPlaying = false;
+
+    if (staticLayer != NULL)
+    {
+        SDL_DestroyTexture(staticLayer);
+        staticLayer = NULL;
+    }
+    staticDirty = true;
+
     SCREEN_WIDTH = SCREEN_HEIGHT = 0;
     gWindow = NULL;
     gRenderer = NULL;
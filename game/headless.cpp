@@ -0,0 +1,296 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "core.hpp"
+#include "replay.hpp"
+#include "perft.hpp"
+#include "bot.hpp"
+
+//Print the end state so runs can be compared
+void printResult(GameCore &core, long steps, double seconds)
+{
+    printf("steps: %ld\nscore: %d\nlines: %d\nboard: %016llx\nseconds: %.3f\nsteps/s: %.0f\n", steps, core.getScore(), core.getLines(),
+           (unsigned long long)core.getBoard().hash(), seconds, steps / seconds);
+}
+
+//Print the heap allocations of the game loop when they are counted
+void printAllocations(AllocStats allocs)
+{
+    if (allocTracking())
+        printf("allocs: %llu\nalloc bytes: %llu\n", (unsigned long long)allocs.count, (unsigned long long)allocs.bytes);
+}
+
+//Play a recorded game back as fast as possible, optionally jumping to a step first
+int playReplay(std::string path, long seekStep)
+{
+    Replay replay;
+    if (!replay.load(path))
+        return 1;
+
+    GameCore core(replay.getSeed());
+    if (seekStep >= 0)
+    {
+        auto seekBegin = std::chrono::steady_clock::now();
+        uint32_t simulated = replay.seek(core, (uint32_t)seekStep);
+        auto seekEnd = std::chrono::steady_clock::now();
+        printf("keyframes: %zu\nseek: %u\nseek simulated: %u\nseek ms: %.3f\nseek board: %016llx\n", replay.getKeyframes(),
+               replay.getPlayStep(), simulated, std::chrono::duration<double, std::milli>(seekEnd - seekBegin).count(),
+               (unsigned long long)core.getBoard().hash());
+    }
+
+    long steps = replay.getPlayStep();
+    AllocStats allocs = allocSnapshot();
+    auto begin = std::chrono::steady_clock::now();
+    {
+        AllocScope strict("replay playback");
+        while (!replay.done())
+        {
+            core.step(replay.next(), STEP_DT);
+            steps++;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    printAllocations(allocSince(allocs));
+
+    printf("seed: %u\nbytes: %zu\n", replay.getSeed(), replay.getData().size());
+    printResult(core, steps, std::chrono::duration<double>(end - begin).count());
+    return 0;
+}
+
+//Play one game with pseudo random inputs, optionally recording it
+int playRandom(long frames, uint32_t seed, std::string recordPath)
+{
+    GameCore core(seed);
+    Replay replay;
+    replay.begin(seed);
+
+    //Inputs from noiseInputs, seeded by the game so runs are reproducible
+    uint32_t noise = seed * 2654435761u + 1;
+
+    long steps = 0;
+    AllocStats allocs = allocSnapshot();
+    auto begin = std::chrono::steady_clock::now();
+    while (steps < frames && !core.isOver())
+    {
+        //The recording grows before the step that fills it, nothing else may allocate
+        replay.reserveAhead(1);
+        AllocScope strict("random game");
+        uint8_t inputs = noiseInputs(noise);
+        replay.record(inputs);
+        core.step(inputs, STEP_DT);
+        replay.checkpoint(core);
+        steps++;
+    }
+    auto end = std::chrono::steady_clock::now();
+    printAllocations(allocSince(allocs));
+    replay.finish();
+
+    printf("seed: %u\nbytes: %zu\n", seed, replay.getData().size());
+    printResult(core, steps, std::chrono::duration<double>(end - begin).count());
+    if (!recordPath.empty() && !replay.save(recordPath))
+        return 1;
+    return 0;
+}
+
+//Let the bot play one game, recording it like a random one
+int playBot(long frames, uint32_t seed, std::string recordPath, int threads, int beamWidth, double budget)
+{
+    GameCore core(seed);
+    Replay replay;
+    replay.begin(seed);
+    Bot bot(threads, beamWidth, BOT_DEPTH, budget);
+    printf("threads: %d\nbeam: %d\nbudget ms: %.3f\n", bot.getThreads(), bot.getBeamWidth(), budget * 1000);
+
+    long steps = 0;
+    AllocStats allocs = allocSnapshot();
+    auto begin = std::chrono::steady_clock::now();
+    while (steps < frames && !core.isOver())
+    {
+        //The recording grows before the step that fills it, nothing else may allocate
+        replay.reserveAhead(1);
+        AllocScope strict("bot game");
+        uint8_t inputs = bot.next(core);
+        replay.record(inputs);
+        core.step(inputs, STEP_DT);
+        replay.checkpoint(core);
+        steps++;
+    }
+    auto end = std::chrono::steady_clock::now();
+    printAllocations(allocSince(allocs));
+    replay.finish();
+
+    double seconds = std::chrono::duration<double>(end - begin).count();
+    int pieces = bot.getPieces();
+    printf("seed: %u\nbytes: %zu\npieces: %d\npieces/s: %.1f\nthink ms: %.3f\nmax think ms: %.3f\n", seed, replay.getData().size(),
+           pieces, pieces / seconds, pieces > 0 ? bot.getThinkSeconds() * 1000 / pieces : 0.0, bot.getMaxThinkSeconds() * 1000);
+    printResult(core, steps, seconds);
+    if (!recordPath.empty() && !replay.save(recordPath))
+        return 1;
+    return 0;
+}
+
+//Read a board drawn as text, one line per row aligned to the bottom, '.' is empty and shape letters pick the color
+bool loadBoard(std::string path, Board &board)
+{
+    FILE *file = fopen(path.c_str(), "r");
+    if (file == NULL)
+    {
+        printf("Unable to read board %s!\n", path.c_str());
+        return false;
+    }
+
+    std::vector<std::string> lines;
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        std::string row(line);
+        while (!row.empty() && isspace((unsigned char)row.back()))
+            row.pop_back();
+        if (!row.empty())
+            lines.push_back(row);
+    }
+    fclose(file);
+
+    if (lines.size() > (size_t)GRID_HEIGHT)
+    {
+        printf("Board %s has more than %d rows!\n", path.c_str(), GRID_HEIGHT);
+        return false;
+    }
+
+    board.clear();
+    const uint16_t cell[1] = {1};
+    int top = GRID_HEIGHT - lines.size();
+    for (size_t y = 0; y < lines.size(); y++)
+        for (size_t x = 0; x < lines[y].size() && x < (size_t)GRID_WIDTH; x++)
+            if (lines[y][x] != '.')
+            {
+                int shape = shapeFromLetter(lines[y][x]);
+                board.place(cell, 1, x, top + y, Colors(shape < 0 ? BLUE : shape));
+            }
+    return true;
+}
+
+//Count every board reachable by placing the queue, level by level
+int runPerft(int depth, uint32_t seed, std::string queueText, std::string boardPath, int threads)
+{
+    Board board;
+    if (!boardPath.empty() && !loadBoard(boardPath, board))
+        return 1;
+
+    //An explicit queue wins over the one dealt from the seed
+    std::vector<Shapes> queue;
+    if (!queueText.empty())
+    {
+        for (char letter: queueText)
+        {
+            int shape = shapeFromLetter(letter);
+            if (shape < 0)
+            {
+                printf("Unknown shape %c in the queue, use %s\n", letter, SHAPE_LETTERS);
+                return 1;
+            }
+            queue.push_back(Shapes(shape));
+        }
+        depth = queue.size();
+    }
+    else
+    {
+        ShapeBag bag(seed);
+        for (int i = 0; i < depth; i++)
+            queue.push_back(bag.next());
+    }
+
+    std::string letters;
+    for (Shapes shape: queue)
+        letters += SHAPE_LETTERS[shape];
+    printf("queue: %s\nthreads: %d\n", letters.c_str(), threads);
+
+    Perft perft;
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<PerftLevel> levels = perft.run(board, queue, threads);
+    auto end = std::chrono::steady_clock::now();
+
+    uint64_t nodes = 0;
+    for (size_t d = 0; d < levels.size(); d++)
+    {
+        printf("depth %zu: %llu nodes, %llu distinct\n", d + 1, (unsigned long long)levels[d].nodes, (unsigned long long)levels[d].distinct);
+        nodes += levels[d].nodes;
+    }
+    double seconds = std::chrono::duration<double>(end - begin).count();
+    printf("nodes: %llu\nseconds: %.3f\nnodes/s: %.0f\n", (unsigned long long)nodes, seconds, nodes / seconds);
+    return 0;
+}
+
+int main(int argc, char *args[])
+{
+    long frames = 1000000;
+    uint32_t seed = 1;
+    long seekStep = -1;
+    int perftDepth = 0;
+    bool botPlays = false;
+    int beamWidth = BOT_BEAM;
+    double budget = BOT_BUDGET;
+    int threads = std::thread::hardware_concurrency();
+    std::string recordPath, replayPath, tracePath, queueText, boardPath;
+
+    //Command line options
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(args[i], "--frames") == 0 && i + 1 < argc)
+            frames = atol(args[++i]);
+        else if (strcmp(args[i], "--seed") == 0 && i + 1 < argc)
+            seed = (uint32_t)strtoul(args[++i], NULL, 10);
+        else if (strcmp(args[i], "--record") == 0 && i + 1 < argc)
+            recordPath = args[++i];
+        else if (strcmp(args[i], "--replay") == 0 && i + 1 < argc)
+            replayPath = args[++i];
+        else if (strcmp(args[i], "--seek") == 0 && i + 1 < argc)
+            seekStep = atol(args[++i]);
+        else if (strcmp(args[i], "--trace") == 0 && i + 1 < argc)
+            tracePath = args[++i];
+        else if (strcmp(args[i], "--strict-alloc") == 0 && i + 1 < argc)
+            setAllocStrict(args[++i]);
+        else if (strcmp(args[i], "--perft") == 0 && i + 1 < argc)
+            perftDepth = atoi(args[++i]);
+        else if (strcmp(args[i], "--queue") == 0 && i + 1 < argc)
+            queueText = args[++i];
+        else if (strcmp(args[i], "--board") == 0 && i + 1 < argc)
+            boardPath = args[++i];
+        else if (strcmp(args[i], "--threads") == 0 && i + 1 < argc)
+            threads = atoi(args[++i]);
+        else if (strcmp(args[i], "--bot") == 0)
+            botPlays = true;
+        else if (strcmp(args[i], "--beam") == 0 && i + 1 < argc)
+            beamWidth = atoi(args[++i]);
+        else if (strcmp(args[i], "--budget") == 0 && i + 1 < argc)
+            budget = atof(args[++i]) / 1000;
+        else
+        {
+            printf("Usage: %s [--frames N] [--seed N] [--record FILE] [--replay FILE [--seek STEP]] [--trace FILE] [--strict-alloc log|abort]\n"
+                   "       %s --perft DEPTH [--seed N | --queue SHAPES] [--board FILE] [--threads N]\n"
+                   "       %s --bot [--frames N] [--seed N] [--record FILE] [--beam WIDTH] [--budget MS] [--threads N]\n", args[0], args[0], args[0]);
+            return 1;
+        }
+    }
+    if (threads < 1)
+        threads = 1;
+
+    if (!tracePath.empty())
+        traceStart();
+
+    int result;
+    if (perftDepth > 0 || !queueText.empty())
+        result = runPerft(perftDepth, seed, queueText, boardPath, threads);
+    else if (botPlays)
+        result = playBot(frames, seed, recordPath, threads, beamWidth, budget);
+    else
+        result = replayPath.empty() ? playRandom(frames, seed, recordPath) : playReplay(replayPath, seekStep);
+    if (!tracePath.empty() && !traceWrite(tracePath))
+        return 1;
+    return result;
+}
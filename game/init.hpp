@@ -2,36 +2,21 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 
-#define INIT_H
+#ifndef DEFS_H
+#include "defs.hpp"
+#endif
 
-enum Shapes
-{
-    S_SHAPE,
-    Z_SHAPE,
-    T_SHAPE,
-    L_SHAPE,
-    I_SHAPE,
-    ML_SHAPE,
-    SQR_SHAPE,
-    SHAPE_TOTAL
-};
+#ifndef ALLOC_H
+#include "alloc.hpp"
+#endif
 
-enum Colors
-{
-    BLUE,
-    GREEN,
-    PURPLE,
-    PINK,
-    RED,
-    YELLOW,
-    TEAL,
-    COLOR_TOTAL
-};
+#define INIT_H
 
 enum GamePhase
 {
     START,
     ONGOING,
+    PAUSED,
     QUIT
 };
 
@@ -49,19 +34,85 @@ enum EButton
 {
     START_BUTTON,
     STOP_BUTTON,
+    PAUSE_BUTTON,
     BUTTON_TOTAL
 };
 
-//Grid dimension
-const int GRID_WIDTH = 15;
-const int GRID_HEIGHT = 30;
+//Image paths indexed by EImage, NULL for images that are not shown yet
+const char *IMAGE_PATHS[IMAGE_TOTAL] = {
+    "Assets/Images/gameAreaBackground.png",
+    "Assets/Images/logo.png",
+    NULL,
+    NULL,
+    NULL
+};
+
+//Button texture paths indexed by EButton
+const char *BUTTON_PATHS[BUTTON_TOTAL] = {
+    "Assets/Textures/UI/start_button.png",
+    "Assets/Textures/UI/quit_button.png",
+    "Assets/Textures/UI/pause_button.png"
+};
+
+//Size of the loading bar shown while assets decode
+const int SPLASH_WIDTH = 400;
+const int SPLASH_HEIGHT = 24;
 
 //Screen dimension constants
 const int SCREEN_WIDTH = 1000;
 const int SCREEN_HEIGHT = 1000;
 
-SDL_Renderer *init(SDL_Window *gWindow, SDL_Renderer *gRenderer) {
+//Upcoming shapes shown next to the grid
+const int PREVIEW_SHAPES = 3;
+const int PREVIEW_X = 200;
+const int PREVIEW_Y = 600;
+const int PREVIEW_SPACING = 100;
+
+//Every game is recorded here unless another path is given
+const char DEFAULT_REPLAY_PATH[] = "last_game.replay";
+
+//Seconds skipped by page up and page down while watching a replay
+const int SEEK_SECONDS = 10;
+
+//Opacity of the landing preview of the current shape
+const Uint8 GHOST_ALPHA = 0x50;
+
+//Frame rate cap used when vsync is unavailable and the display rate is unknown
+const int FALLBACK_FRAME_RATE = 60;
+
+//Longest sleep while waiting for events in the menu or when paused, in milliseconds
+const int IDLE_WAIT_MS = 1000;
+
+//Longest frame the simulation catches up on, so a stall does not trigger a burst of steps
+const double MAX_FRAME_TIME = 0.25;
+
+#if defined(TRACK_ALLOCATIONS) && SDL_VERSION_ATLEAST(2, 0, 7)
+//SDL allocations are counted together with the C++ ones
+void *countedMalloc(size_t size)
+{
+    allocCount(size);
+    return malloc(size);
+}
+
+void *countedCalloc(size_t count, size_t size)
+{
+    allocCount(count * size);
+    return calloc(count, size);
+}
+
+void *countedRealloc(void *p, size_t size)
+{
+    allocCount(size);
+    return realloc(p, size);
+}
+#endif
+
+//Create the window and its renderer, the window is handed back through gWindow
+SDL_Renderer *init(SDL_Window *&gWindow, SDL_Renderer *gRenderer) {
     bool success = true;
+#if defined(TRACK_ALLOCATIONS) && SDL_VERSION_ATLEAST(2, 0, 7)
+    SDL_SetMemoryFunctions(countedMalloc, countedCalloc, countedRealloc, free);
+#endif
     if ( SDL_Init( SDL_INIT_VIDEO ) < 0) {
         printf("SDL could not initialize! SDL_Error: %s\n", SDL_GetError());
         success = false;
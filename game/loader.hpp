@@ -0,0 +1,183 @@
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <SDL2/SDL.h>
+
+#ifndef TRACE_H
+#include "trace.hpp"
+#endif
+
+#ifndef REGISTRY_H
+#include "registry.hpp"
+#endif
+
+#define LOADER_H
+
+//Most decoding threads, a dozen small images gain nothing from more
+const int LOADER_THREADS = 4;
+
+//An image a worker finished decoding
+struct DecodedAsset
+{
+    //Index into the names given to start
+    int index;
+
+    //Decoded pixels, NULL if decoding failed, owned by whoever takes it
+    SDL_Surface *surface;
+};
+
+//Decodes images on a small pool of threads and hands the surfaces back to the main thread
+//Textures must still be created on the render thread, so the caller uploads what next() returns
+class AssetLoader
+{
+    public:
+        //Constructor
+        AssetLoader();
+
+        //Destructor
+        ~AssetLoader();
+
+        //Start decoding these logical names
+        void start(const std::vector<std::string> &names);
+
+        //Take a decoded image if one is ready, never blocks
+        bool next(DecodedAsset &asset);
+
+        //Get the name of a job
+        const std::string &getName(int index) const;
+
+        //Get the number of images, and the number handed back by next
+        int getTotal() const;
+        int getDone() const;
+
+        //Get the number of worker threads
+        int getThreads() const;
+
+        //Check if every image was handed back
+        bool isFinished() const;
+
+        //Skip the jobs not yet started, wait for the workers and free what was never taken
+        void stop();
+
+    private:
+        //Worker loop
+        void work();
+
+        //Images to decode
+        std::vector<std::string> names;
+
+        //Worker threads
+        std::vector<std::thread> workers;
+
+        //Next job to claim
+        std::atomic<int> nextJob;
+
+        //Decoded images not yet taken, guarded by mutex
+        std::mutex mutex;
+        std::deque<DecodedAsset> decoded;
+
+        //Images handed back
+        int done;
+};
+
+AssetLoader::AssetLoader()
+{
+    nextJob = 0;
+    done = 0;
+}
+
+AssetLoader::~AssetLoader()
+{
+    stop();
+}
+
+void AssetLoader::start(const std::vector<std::string> &names)
+{
+    stop();
+    this->names = names;
+    nextJob = 0;
+    done = 0;
+
+    int threads = std::thread::hardware_concurrency();
+    if (threads > LOADER_THREADS)
+        threads = LOADER_THREADS;
+    if (threads > (int)names.size())
+        threads = names.size();
+    if (threads < 1)
+        threads = 1;
+    for (int i = 0; i < threads; i++)
+        workers.push_back(std::thread(&AssetLoader::work, this));
+}
+
+void AssetLoader::work()
+{
+    while (true)
+    {
+        int index = nextJob++;
+        if (index >= (int)names.size())
+            return;
+
+        DecodedAsset asset = { index, NULL };
+        {
+            TRACE_ZONE("AssetLoader::decode");
+            asset.surface = loadSurface(names[index]);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        decoded.push_back(asset);
+    }
+}
+
+bool AssetLoader::next(DecodedAsset &asset)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (decoded.empty())
+        return false;
+
+    asset = decoded.front();
+    decoded.pop_front();
+    done++;
+    return true;
+}
+
+const std::string &AssetLoader::getName(int index) const
+{
+    return names[index];
+}
+
+int AssetLoader::getTotal() const
+{
+    return names.size();
+}
+
+int AssetLoader::getDone() const
+{
+    return done;
+}
+
+int AssetLoader::getThreads() const
+{
+    return workers.size();
+}
+
+bool AssetLoader::isFinished() const
+{
+    return done == (int)names.size();
+}
+
+void AssetLoader::stop()
+{
+    nextJob = names.size();
+    for (std::thread &worker: workers)
+        worker.join();
+    workers.clear();
+
+    for (DecodedAsset &asset: decoded)
+        if (asset.surface != NULL)
+            SDL_FreeSurface(asset.surface);
+    decoded.clear();
+}
@@ -1,13 +1,49 @@
+#include <stdlib.h>
+#include <string.h>
 #include "init.hpp"
 #include "game.hpp"
 
 int main(int argc, char *args[])
 {
+    //Time to first frame counts window creation too
+    Uint64 launch = SDL_GetPerformanceCounter();
     SDL_Window *gWindow = NULL;
     SDL_Renderer *gRenderer = NULL;
     gRenderer = init(gWindow, gRenderer);
     Game tetris = Game(SCREEN_WIDTH, SCREEN_HEIGHT, gWindow, gRenderer);
+    tetris.setLaunchTime(launch);
+    std::string tracePath;
+    std::string bundlePath = DEFAULT_BUNDLE_PATH;
+
+    //Command line options
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(args[i], "--seed") == 0 && i + 1 < argc)
+            tetris.setSeed((Uint32)strtoul(args[++i], NULL, 10));
+        else if (strcmp(args[i], "--record") == 0 && i + 1 < argc)
+            tetris.setRecordPath(args[++i]);
+        else if (strcmp(args[i], "--replay") == 0 && i + 1 < argc)
+            tetris.loadReplay(args[++i]);
+        else if (strcmp(args[i], "--speed") == 0 && i + 1 < argc)
+            tetris.setPlaybackSpeed(atof(args[++i]));
+        else if (strcmp(args[i], "--trace") == 0 && i + 1 < argc)
+            tracePath = args[++i];
+        else if (strcmp(args[i], "--strict-alloc") == 0 && i + 1 < argc)
+            setAllocStrict(args[++i]);
+        else if (strcmp(args[i], "--bundle") == 0 && i + 1 < argc)
+            bundlePath = args[++i];
+        else if (strcmp(args[i], "--bot") == 0)
+            tetris.setBot(true);
+    }
+
+    //Images that are neither embedded nor in the bundle are decoded from Assets
+    gAssets.openBundle(bundlePath);
+
+    if (!tracePath.empty())
+        traceStart();
     tetris.startGame();
+    if (!tracePath.empty())
+        traceWrite(tracePath);
     close(gWindow, gRenderer);
 }
 
@@ -0,0 +1,316 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <algorithm>
+#include <SDL2/SDL.h>
+
+#ifndef ALLOC_H
+#include "alloc.hpp"
+#endif
+
+#define OVERLAY_H
+
+//Parts of a frame that are timed separately
+enum FrameSection
+{
+    SECTION_INPUT,
+    SECTION_UPDATE,
+    SECTION_STATIC,
+    SECTION_DYNAMIC,
+    SECTION_PRESENT,
+    SECTION_TOTAL
+};
+
+//Labels of the sections, in FrameSection order
+const char *SECTION_NAMES[SECTION_TOTAL] = {"IN", "UPD", "STA", "DYN", "PRE"};
+
+//Frames kept for the percentiles and the graph
+const int FRAME_HISTORY = 240;
+
+//Overlay placement and size
+const int OVERLAY_X = 8;
+const int OVERLAY_Y = 8;
+const int OVERLAY_WIDTH = 300;
+const int OVERLAY_HEIGHT = 250;
+
+//Height of the graph and the frame time it spans, in milliseconds
+const int GRAPH_HEIGHT = 80;
+const double GRAPH_MS = 50.0;
+
+//Pixels per font dot
+const int FONT_SCALE = 2;
+
+//Glyphs are 3 dots wide and 5 tall, stored row by row from the top bit down
+const int GLYPH_WIDTH = 3;
+const int GLYPH_HEIGHT = 5;
+
+//Dots queued before they are drawn in one call
+const int OVERLAY_RECTS = 1024;
+
+//A 3x5 glyph
+struct Glyph
+{
+    char c;
+    uint16_t bits;
+};
+
+//The characters the overlay prints
+const Glyph FONT[] = {
+    {'0', 0b111101101101111}, {'1', 0b010110010010111}, {'2', 0b111001111100111}, {'3', 0b111001111001111},
+    {'4', 0b101101111001001}, {'5', 0b111100111001111}, {'6', 0b111100111101111}, {'7', 0b111001001001001},
+    {'8', 0b111101111101111}, {'9', 0b111101111001111}, {'.', 0b000000000000010}, {'/', 0b001001010100100},
+    {'A', 0b010101111101101}, {'B', 0b110101110101110}, {'C', 0b011100100100011}, {'D', 0b110101101101110}, {'E', 0b111100110100111}, {'F', 0b111100110100100},
+    {'I', 0b111010010010111}, {'L', 0b100100100100111}, {'M', 0b101111111101101}, {'N', 0b110101101101101},
+    {'O', 0b010101101101010}, {'P', 0b110101110100100},
+    {'R', 0b110101110101101}, {'S', 0b011100010001110}, {'T', 0b111010010010010}, {'U', 0b101101101101111},
+    {'X', 0b101101010101101}, {'Y', 0b101101010010010}
+};
+
+//Frame time statistics and a graph drawn over the game, built from rects and lines so it needs no font library
+class Overlay
+{
+    public:
+        //Constructor
+        Overlay();
+
+        //Show or hide the overlay
+        void toggle();
+
+        //Check if the overlay is shown
+        bool isVisible() const;
+
+        //Start timing a new frame
+        void beginFrame();
+
+        //Add counter ticks spent in a section of the current frame
+        void addSection(FrameSection section, Uint64 ticks);
+
+        //Close the current frame with its total counter ticks and the heap allocations made during it
+        void endFrame(Uint64 ticks, AllocStats allocations);
+
+        //Draw the overlay
+        void render(SDL_Renderer *gRenderer);
+
+    private:
+        //Convert counter ticks to milliseconds
+        double toMs(Uint64 ticks) const;
+
+        //Get a frame time percentile over the history, in milliseconds
+        double percentile(int percent);
+
+        //Queue the dots of a text line
+        void queueText(SDL_Renderer *gRenderer, int x, int y, const char *text);
+
+        //Draw the queued dots
+        void flushRects(SDL_Renderer *gRenderer);
+
+        //Flag set while the overlay is shown
+        bool visible;
+
+        //Performance counter ticks per second
+        Uint64 counterFrequency;
+
+        //Ring of frame times and section times in counter ticks
+        Uint64 frames[FRAME_HISTORY];
+        Uint64 sections[SECTION_TOTAL][FRAME_HISTORY];
+        AllocStats allocations[FRAME_HISTORY];
+
+        //Section times of the frame being measured
+        Uint64 current[SECTION_TOTAL];
+
+        //Next slot of the ring and number of frames stored
+        int head;
+        int count;
+
+        //Scratch space for sorting and drawing, kept here so drawing never allocates
+        double sorted[FRAME_HISTORY];
+        SDL_Point graph[FRAME_HISTORY];
+        SDL_Rect rects[OVERLAY_RECTS];
+        int rectCount;
+};
+
+Overlay::Overlay()
+{
+    visible = false;
+    counterFrequency = SDL_GetPerformanceFrequency();
+    head = 0;
+    count = 0;
+    rectCount = 0;
+    beginFrame();
+}
+
+void Overlay::toggle()
+{
+    visible = !visible;
+}
+
+bool Overlay::isVisible() const
+{
+    return visible;
+}
+
+void Overlay::beginFrame()
+{
+    for (int i = 0; i < SECTION_TOTAL; i++)
+        current[i] = 0;
+}
+
+void Overlay::addSection(FrameSection section, Uint64 ticks)
+{
+    current[section] += ticks;
+}
+
+void Overlay::endFrame(Uint64 ticks, AllocStats allocations)
+{
+    frames[head] = ticks;
+    this->allocations[head] = allocations;
+    for (int i = 0; i < SECTION_TOTAL; i++)
+        sections[i][head] = current[i];
+    head = (head + 1) % FRAME_HISTORY;
+    if (count < FRAME_HISTORY)
+        count++;
+    beginFrame();
+}
+
+double Overlay::toMs(Uint64 ticks) const
+{
+    return ticks * 1000.0 / counterFrequency;
+}
+
+double Overlay::percentile(int percent)
+{
+    if (count == 0)
+        return 0;
+
+    for (int i = 0; i < count; i++)
+        sorted[i] = toMs(frames[i]);
+    int index = (count - 1) * percent / 100;
+    std::nth_element(sorted, sorted + index, sorted + count);
+    return sorted[index];
+}
+
+void Overlay::queueText(SDL_Renderer *gRenderer, int x, int y, const char *text)
+{
+    for (; *text; text++, x += (GLYPH_WIDTH + 1) * FONT_SCALE)
+    {
+        char c = toupper(*text);
+        uint16_t bits = 0;
+        for (const Glyph &glyph: FONT)
+            if (glyph.c == c)
+                bits = glyph.bits;
+
+        for (int dot = 0; dot < GLYPH_WIDTH * GLYPH_HEIGHT; dot++)
+        {
+            if (!(bits & (1 << (GLYPH_WIDTH * GLYPH_HEIGHT - 1 - dot))))
+                continue;
+            if (rectCount == OVERLAY_RECTS)
+                flushRects(gRenderer);
+            SDL_Rect &rect = rects[rectCount++];
+            rect.x = x + dot % GLYPH_WIDTH * FONT_SCALE;
+            rect.y = y + dot / GLYPH_WIDTH * FONT_SCALE;
+            rect.w = rect.h = FONT_SCALE;
+        }
+    }
+}
+
+void Overlay::flushRects(SDL_Renderer *gRenderer)
+{
+    if (rectCount > 0)
+        SDL_RenderFillRects(gRenderer, rects, rectCount);
+    rectCount = 0;
+}
+
+void Overlay::render(SDL_Renderer *gRenderer)
+{
+    if (!visible)
+        return;
+
+    //Translucent panel
+    SDL_BlendMode blend;
+    SDL_GetRenderDrawBlendMode(gRenderer, &blend);
+    SDL_SetRenderDrawBlendMode(gRenderer, SDL_BLENDMODE_BLEND);
+    SDL_Rect panel = { OVERLAY_X, OVERLAY_Y, OVERLAY_WIDTH, OVERLAY_HEIGHT };
+    SDL_SetRenderDrawColor(gRenderer, 0x00, 0x00, 0x00, 0xC0);
+    SDL_RenderFillRect(gRenderer, &panel);
+
+    //Text and bars are white, set before queueing because a full queue is drawn right away
+    SDL_SetRenderDrawColor(gRenderer, 0xFF, 0xFF, 0xFF, 0xFF);
+
+    //Frame time summary
+    double total = 0;
+    double maximum = 0;
+    for (int i = 0; i < count; i++)
+    {
+        double ms = toMs(frames[i]);
+        total += ms;
+        if (ms > maximum)
+            maximum = ms;
+    }
+    double mean = count > 0 ? total / count : 0;
+
+    char line[64];
+    int x = OVERLAY_X + 8;
+    int y = OVERLAY_Y + 8;
+    int lineHeight = (GLYPH_HEIGHT + 2) * FONT_SCALE;
+    snprintf(line, sizeof(line), "FPS %.1f", mean > 0 ? 1000.0 / mean : 0.0);
+    queueText(gRenderer, x, y, line);
+    snprintf(line, sizeof(line), "P50 %.2f P99 %.2f MAX %.2f MS", percentile(50), percentile(99), maximum);
+    queueText(gRenderer, x, y += lineHeight, line);
+
+    //Heap allocations of the last frame and the most in one frame
+    if (allocTracking() && count > 0)
+    {
+        const AllocStats &last = allocations[(head + FRAME_HISTORY - 1) % FRAME_HISTORY];
+        uint64_t most = 0;
+        for (int i = 0; i < count; i++)
+            most = std::max(most, allocations[i].count);
+        snprintf(line, sizeof(line), "ALLOC %llu / %llu B MAX %llu", (unsigned long long)last.count, (unsigned long long)last.bytes,
+                 (unsigned long long)most);
+    }
+    else
+        snprintf(line, sizeof(line), "ALLOC OFF");
+    queueText(gRenderer, x, y += lineHeight, line);
+
+    //Mean of every section with a bar scaled to a 60 Hz frame
+    y += lineHeight / 2;
+    for (int s = 0; s < SECTION_TOTAL; s++)
+    {
+        Uint64 ticks = 0;
+        for (int i = 0; i < count; i++)
+            ticks += sections[s][i];
+        double ms = count > 0 ? toMs(ticks) / count : 0;
+
+        snprintf(line, sizeof(line), "%s %.3f", SECTION_NAMES[s], ms);
+        queueText(gRenderer, x, y += lineHeight, line);
+        if (rectCount == OVERLAY_RECTS)
+            flushRects(gRenderer);
+        SDL_Rect &bar = rects[rectCount++];
+        bar.x = x + 120;
+        bar.y = y;
+        bar.w = std::min(120, std::max(1, (int)(ms * 120 * 60 / 1000)));
+        bar.h = GLYPH_HEIGHT * FONT_SCALE;
+    }
+    flushRects(gRenderer);
+
+    //Frame time graph, oldest frame on the left, with guides at 60 and 30 Hz
+    int graphBottom = OVERLAY_Y + OVERLAY_HEIGHT - 8;
+    SDL_SetRenderDrawColor(gRenderer, 0x60, 0x60, 0x60, 0xFF);
+    for (double guide = 1000.0 / 60; guide < 1000.0 / 20; guide *= 2)
+    {
+        int gy = graphBottom - (int)(guide * GRAPH_HEIGHT / GRAPH_MS);
+        SDL_RenderDrawLine(gRenderer, x, gy, x + FRAME_HISTORY - 1, gy);
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        int index = (head - count + i + FRAME_HISTORY) % FRAME_HISTORY;
+        double ms = std::min(toMs(frames[index]), GRAPH_MS);
+        graph[i].x = x + FRAME_HISTORY - count + i;
+        graph[i].y = graphBottom - (int)(ms * GRAPH_HEIGHT / GRAPH_MS);
+    }
+    SDL_SetRenderDrawColor(gRenderer, 0x40, 0xFF, 0x40, 0xFF);
+    if (count > 1)
+        SDL_RenderDrawLines(gRenderer, graph, count);
+
+    SDL_SetRenderDrawBlendMode(gRenderer, blend);
+}
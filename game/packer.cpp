@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include "bundle.hpp"
+
+//Folders packed when none are given
+const char *DEFAULT_PACK_DIRS[] = {"Assets/Images", "Assets/Textures"};
+
+//Pixel formats the packer can write, ARGB8888 is the native texture format of most renderers
+struct PackFormat
+{
+    const char *name;
+    Uint32 format;
+};
+
+const PackFormat PACK_FORMATS[] = {
+    {"argb8888", SDL_PIXELFORMAT_ARGB8888},
+    {"abgr8888", SDL_PIXELFORMAT_ABGR8888},
+    {"rgba8888", SDL_PIXELFORMAT_RGBA8888},
+    {"bgra8888", SDL_PIXELFORMAT_BGRA8888}
+};
+
+//One decoded image waiting to be written
+struct PackedImage
+{
+    BundleEntry entry;
+    SDL_Surface *surface;
+};
+
+//Collect every PNG under a folder, named by its path the way the game asks for it
+void findImages(std::string dir, std::vector<std::string> &paths)
+{
+    std::error_code error;
+    for (auto it = std::filesystem::recursive_directory_iterator(dir, error); !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+    {
+        std::string extension = it->path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        if (it->is_regular_file() && extension == ".png")
+            paths.push_back(it->path().generic_string());
+    }
+    if (error)
+        printf("Unable to read %s: %s\n", dir.c_str(), error.message().c_str());
+}
+
+//Write the header, the index and the pixels
+bool writeBundle(std::string path, std::vector<PackedImage> &images)
+{
+    FILE *file = fopen(path.c_str(), "wb");
+    if (file == NULL)
+    {
+        printf("Unable to write bundle %s!\n", path.c_str());
+        return false;
+    }
+
+    BundleHeader header;
+    memcpy(header.magic, BUNDLE_MAGIC, sizeof(header.magic));
+    header.version = BUNDLE_VERSION;
+    header.count = images.size();
+    header.reserved = 0;
+
+    //Lay out the pixels after the index, each image aligned
+    uint64_t offset = sizeof(BundleHeader) + images.size() * sizeof(BundleEntry);
+    for (PackedImage &image: images)
+    {
+        offset = (offset + BUNDLE_ALIGN - 1) / BUNDLE_ALIGN * BUNDLE_ALIGN;
+        image.entry.offset = offset;
+        offset += image.entry.size;
+    }
+
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (PackedImage &image: images)
+        success = success && fwrite(&image.entry, sizeof(BundleEntry), 1, file) == 1;
+
+    //Rows are written tightly packed, the entry pitch is width * bytes per pixel
+    static const uint8_t padding[BUNDLE_ALIGN] = {0};
+    uint64_t written = sizeof(BundleHeader) + images.size() * sizeof(BundleEntry);
+    for (PackedImage &image: images)
+    {
+        success = success && fwrite(padding, 1, image.entry.offset - written, file) == image.entry.offset - written;
+        SDL_Surface *surface = image.surface;
+        SDL_LockSurface(surface);
+        for (uint32_t y = 0; y < image.entry.height; y++)
+            success = success && fwrite((uint8_t *)surface->pixels + y * surface->pitch, 1, image.entry.pitch, file) == image.entry.pitch;
+        SDL_UnlockSurface(surface);
+        written = image.entry.offset + image.entry.size;
+    }
+    return fclose(file) == 0 && success;
+}
+
+int main(int argc, char *args[])
+{
+    std::string outPath = DEFAULT_BUNDLE_PATH;
+    Uint32 format = SDL_PIXELFORMAT_ARGB8888;
+    std::vector<std::string> dirs;
+
+    //Command line options, anything else is a folder to pack
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(args[i], "--out") == 0 && i + 1 < argc)
+            outPath = args[++i];
+        else if (strcmp(args[i], "--format") == 0 && i + 1 < argc)
+        {
+            const char *name = args[++i];
+            format = SDL_PIXELFORMAT_UNKNOWN;
+            for (const PackFormat &f: PACK_FORMATS)
+                if (strcmp(f.name, name) == 0)
+                    format = f.format;
+            if (format == SDL_PIXELFORMAT_UNKNOWN)
+            {
+                printf("Unknown format %s, use argb8888, abgr8888, rgba8888 or bgra8888\n", name);
+                return 1;
+            }
+        }
+        else if (args[i][0] == '-')
+        {
+            printf("Usage: %s [--out FILE] [--format NAME] [FOLDER...]\n", args[0]);
+            return 1;
+        }
+        else
+            dirs.push_back(args[i]);
+    }
+    if (dirs.empty())
+        dirs.assign(DEFAULT_PACK_DIRS, DEFAULT_PACK_DIRS + sizeof(DEFAULT_PACK_DIRS) / sizeof(DEFAULT_PACK_DIRS[0]));
+
+    if (!(IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG))
+    {
+        printf("SDL_image could not initialize! SDL_image Error: %s\n", IMG_GetError());
+        return 1;
+    }
+
+    std::vector<std::string> paths;
+    for (std::string &dir: dirs)
+        findImages(dir, paths);
+    std::sort(paths.begin(), paths.end());
+
+    //Decode and convert everything up front so the game never has to
+    std::vector<PackedImage> images;
+    bool success = true;
+    for (std::string &path: paths)
+    {
+        if (path.size() >= BUNDLE_NAME)
+        {
+            printf("Path too long for a bundle: %s\n", path.c_str());
+            success = false;
+            continue;
+        }
+
+        SDL_Surface *loaded = IMG_Load(path.c_str());
+        SDL_Surface *converted = loaded != NULL ? SDL_ConvertSurfaceFormat(loaded, format, 0) : NULL;
+        if (loaded != NULL)
+            SDL_FreeSurface(loaded);
+        if (converted == NULL)
+        {
+            printf("Unable to convert %s! SDL Error: %s\n", path.c_str(), SDL_GetError());
+            success = false;
+            continue;
+        }
+
+        PackedImage image;
+        memset(&image.entry, 0, sizeof(image.entry));
+        strcpy(image.entry.name, path.c_str());
+        image.entry.format = format;
+        image.entry.width = converted->w;
+        image.entry.height = converted->h;
+        image.entry.pitch = converted->w * SDL_BYTESPERPIXEL(format);
+        image.entry.size = (uint64_t)image.entry.pitch * converted->h;
+        image.surface = converted;
+        images.push_back(image);
+    }
+
+    if (success)
+        success = writeBundle(outPath, images);
+
+    uint64_t bytes = 0;
+    for (PackedImage &image: images)
+    {
+        bytes += image.entry.size;
+        SDL_FreeSurface(image.surface);
+    }
+    IMG_Quit();
+
+    if (!success)
+        return 1;
+    printf("Packed %zu images, %llu bytes of pixels, into %s\n", images.size(), (unsigned long long)bytes, outPath.c_str());
+    return 0;
+}
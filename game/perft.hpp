@@ -0,0 +1,396 @@
+#include <ctype.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#ifndef BOARD_H
+#include "board.hpp"
+#endif
+
+#ifndef SHAPE_H
+#include "shape.hpp"
+#endif
+
+#ifndef PLACEMENT_H
+#include "placement.hpp"
+#endif
+
+#define PERFT_H
+
+//Letters of the shapes in queues and board files, J is ML_SHAPE and O is SQR_SHAPE
+const char SHAPE_LETTERS[SHAPE_TOTAL + 1] = "SZTLIJO";
+
+//Get the shape of a letter, -1 if it names none
+int shapeFromLetter(char letter)
+{
+    for (int i = 0; i < SHAPE_TOTAL; i++)
+        if (SHAPE_LETTERS[i] == toupper(letter))
+            return i;
+    return -1;
+}
+
+//Counts of one depth of the placement tree
+struct PerftLevel
+{
+    //Paths through the tree that end at this depth
+    uint64_t nodes;
+
+    //Boards among them with different cells filled, colors aside
+    //Each distinct board is kept exactly, once per thread that reached it, so memory grows with the distinct boards
+    uint64_t distinct;
+};
+
+//Rows of a board the way PerftBoardSet stores them, from the highest filled one down, with their hash
+struct PerftKey
+{
+    uint64_t hash;
+    int length;
+    uint16_t rows[GRID_HEIGHT];
+};
+
+//Boards compared by their exact rows, so a hash collision can never merge two of them
+//Each board is stored as a row count and its rows from the highest filled one down
+class PerftBoardSet
+{
+    public:
+        //Constructor
+        PerftBoardSet();
+
+        //Pack the rows of a board into a key
+        static void pack(const Board &board, PerftKey &key);
+
+        //Start loading the slot a key probes first, so a batch of inserts can overlap its cache misses
+        void prefetch(const PerftKey &key) const;
+
+        //Add a board, false if the same rows are already in
+        bool insert(const PerftKey &key);
+        bool insert(const Board &board);
+
+        //Add every board of another set
+        void merge(const PerftBoardSet &other);
+
+        //Get the number of boards
+        uint64_t size() const;
+
+        //Drop every board and its memory
+        void free();
+
+    private:
+        //Add packed rows, false if already in
+        bool insertRows(const uint16_t *rows, int length, uint64_t hash);
+
+        //Get the FNV-1a hash of packed rows
+        static uint64_t hashRows(const uint16_t *rows, int length);
+
+        //Get the slot a hash starts probing at
+        size_t home(uint64_t hash) const;
+
+        //Double the table once it is three quarters full
+        void grow();
+
+        //Open addressing table, the top bits of a slot are the top bits of the board hash
+        //and the rest is the position of the board in blocks plus one, 0 is an empty slot
+        std::vector<uint64_t> slots;
+        int slotBits;
+
+        //Get the stored key at a position
+        const uint16_t *key(uint64_t position) const;
+
+        //Row counts each followed by the rows, in fixed blocks so growing never copies them
+        std::vector<std::vector<uint16_t>> blocks;
+
+        uint64_t count;
+};
+
+//Walks every sequence of placements of a queue of shapes, the way chess engines check their move generators
+//The root placements are shared between threads, each walks its subtrees depth first
+class Perft
+{
+    public:
+        //Constructor
+        Perft();
+
+        //Count the tree of queue[0..depth) placed on board, one level per depth
+        std::vector<PerftLevel> run(const Board &board, const std::vector<Shapes> &queue, int threads);
+
+    private:
+        //State of one thread
+        struct Worker
+        {
+            PlacementGenerator generator;
+
+            //One list per depth so the recursion does not build its own
+            std::vector<PlacementList> lists;
+
+            //Nodes and distinct boards per depth
+            std::vector<uint64_t> nodes;
+            std::vector<PerftBoardSet> boards;
+
+            //Keys of the placements being counted
+            std::vector<PerftKey> keys;
+        };
+
+        //Walk everything below a board where queue[depth] is next
+        void walk(Worker &worker, const Board &board, int depth);
+
+        //Shapes to place
+        std::vector<Shapes> queue;
+};
+
+//Hash bits kept in a slot, they pick the slot without reading the rows while the table has up to 2^PERFT_TAG_BITS slots
+const int PERFT_TAG_BITS = 28;
+const uint64_t PERFT_OFFSET_MASK = (1ull << (64 - PERFT_TAG_BITS)) - 1;
+
+//Rows held by one block of keys
+const size_t PERFT_BLOCK = 1 << 20;
+
+PerftBoardSet::PerftBoardSet()
+{
+    count = 0;
+    slotBits = 0;
+}
+
+const uint16_t *PerftBoardSet::key(uint64_t position) const
+{
+    return &blocks[position / PERFT_BLOCK][position % PERFT_BLOCK];
+}
+
+size_t PerftBoardSet::home(uint64_t hash) const
+{
+    return hash >> (64 - slotBits);
+}
+
+uint64_t PerftBoardSet::hashRows(const uint16_t *rows, int length)
+{
+    uint64_t hash = 0xCBF29CE484222325ull ^ length;
+    for (int i = 0; i < length; i++)
+        hash = (hash ^ rows[i]) * 0x100000001B3ull;
+    return hash;
+}
+
+void PerftBoardSet::pack(const Board &board, PerftKey &key)
+{
+    //Empty rows above the stack are left out, the row count keeps boards of different heights apart
+    int top = 0;
+    while (top < GRID_HEIGHT && board.getRow(top) == 0)
+        top++;
+    key.length = GRID_HEIGHT - top;
+    for (int i = 0; i < key.length; i++)
+        key.rows[i] = board.getRow(top + i);
+    key.hash = hashRows(key.rows, key.length);
+}
+
+void PerftBoardSet::prefetch(const PerftKey &key) const
+{
+    if (!slots.empty())
+        __builtin_prefetch(&slots[home(key.hash)]);
+}
+
+bool PerftBoardSet::insert(const PerftKey &key)
+{
+    return insertRows(key.rows, key.length, key.hash);
+}
+
+bool PerftBoardSet::insert(const Board &board)
+{
+    PerftKey key;
+    pack(board, key);
+    return insert(key);
+}
+
+bool PerftBoardSet::insertRows(const uint16_t *rows, int length, uint64_t hash)
+{
+    if ((count + 1) * 4 > slots.size() * 3)
+        grow();
+
+    uint64_t tag = hash & ~PERFT_OFFSET_MASK;
+    size_t mask = slots.size() - 1;
+    for (size_t i = home(hash);; i = (i + 1) & mask)
+    {
+        if (slots[i] == 0)
+        {
+            //A key never straddles two blocks
+            if (blocks.empty() || blocks.back().size() + length + 1 > PERFT_BLOCK)
+            {
+                blocks.emplace_back();
+                blocks.back().reserve(PERFT_BLOCK);
+            }
+            std::vector<uint16_t> &block = blocks.back();
+            slots[i] = tag | ((blocks.size() - 1) * PERFT_BLOCK + block.size() + 1);
+            block.push_back(length);
+            block.insert(block.end(), rows, rows + length);
+            count++;
+            return true;
+        }
+
+        //Rows are only read when the tags agree
+        if ((slots[i] & ~PERFT_OFFSET_MASK) != tag)
+            continue;
+        const uint16_t *stored = key((slots[i] & PERFT_OFFSET_MASK) - 1);
+        if (stored[0] == length && memcmp(stored + 1, rows, length * sizeof(rows[0])) == 0)
+            return false;
+    }
+}
+
+void PerftBoardSet::grow()
+{
+    std::vector<uint64_t> old;
+    old.swap(slots);
+    slotBits = old.empty() ? 10 : slotBits + 1;
+    slots.assign((size_t)1 << slotBits, 0);
+
+    size_t mask = slots.size() - 1;
+    for (uint64_t slot: old)
+    {
+        if (slot == 0)
+            continue;
+
+        //Past the tag bits the hash has to be taken from the rows again
+        uint64_t hash = slot;
+        if (slotBits > PERFT_TAG_BITS)
+        {
+            const uint16_t *stored = key((slot & PERFT_OFFSET_MASK) - 1);
+            hash = hashRows(stored + 1, stored[0]);
+        }
+        size_t i = home(hash);
+        while (slots[i] != 0)
+            i = (i + 1) & mask;
+        slots[i] = slot;
+    }
+}
+
+void PerftBoardSet::merge(const PerftBoardSet &other)
+{
+    //Walking the keys instead of the slots keeps the inserts out of hash order, which would pile them into long probe runs
+    for (const std::vector<uint16_t> &block: other.blocks)
+        for (size_t i = 0; i < block.size(); i += block[i] + 1)
+            insertRows(&block[i + 1], block[i], hashRows(&block[i + 1], block[i]));
+}
+
+uint64_t PerftBoardSet::size() const
+{
+    return count;
+}
+
+void PerftBoardSet::free()
+{
+    std::vector<uint64_t>().swap(slots);
+    std::vector<std::vector<uint16_t>>().swap(blocks);
+    count = 0;
+    slotBits = 0;
+}
+
+Perft::Perft()
+{
+}
+
+void Perft::walk(Worker &worker, const Board &board, int depth)
+{
+    //A shape that cannot spawn ends the game
+    Shape shape(queue[depth]);
+    if (shape.checkBlocked(board))
+        return;
+
+    PlacementList &list = worker.lists[depth];
+    worker.generator.generate(board, shape, list);
+    worker.nodes[depth] += list.count;
+
+    //All children are packed and their slots requested before any is inserted, so the table misses overlap
+    PerftBoardSet &boards = worker.boards[depth];
+    for (int i = 0; i < list.count; i++)
+    {
+        Board next = board;
+        lockPlacement(next, queue[depth], list.placements[i]);
+        PerftBoardSet::pack(next, worker.keys[i]);
+        boards.prefetch(worker.keys[i]);
+    }
+    for (int i = 0; i < list.count; i++)
+        boards.insert(worker.keys[i]);
+
+    if (depth + 1 == (int)queue.size())
+        return;
+    for (int i = 0; i < list.count; i++)
+    {
+        Board next = board;
+        lockPlacement(next, queue[depth], list.placements[i]);
+        walk(worker, next, depth + 1);
+    }
+}
+
+std::vector<PerftLevel> Perft::run(const Board &board, const std::vector<Shapes> &queue, int threads)
+{
+    TRACE_ZONE("Perft::run");
+    this->queue = queue;
+    int depth = queue.size();
+    std::vector<PerftLevel> levels(depth);
+    if (depth == 0)
+        return levels;
+    if (threads < 1)
+        threads = 1;
+
+    std::vector<Worker> workers(threads);
+    for (Worker &worker: workers)
+    {
+        worker.lists.resize(depth);
+        worker.nodes.assign(depth, 0);
+        worker.boards.resize(depth);
+        worker.keys.resize(MAX_PLACEMENTS);
+    }
+
+    //The first level is generated once, then its subtrees are handed out one at a time
+    Shape shape(queue[0]);
+    PlacementList &roots = workers[0].lists[0];
+    if (shape.checkBlocked(board) || workers[0].generator.generate(board, shape, roots) == 0)
+        return levels;
+
+    std::vector<Board> rootBoards;
+    for (int i = 0; i < roots.count; i++)
+    {
+        rootBoards.push_back(board);
+        lockPlacement(rootBoards.back(), queue[0], roots.placements[i]);
+    }
+    levels[0].nodes = roots.count;
+    for (const Board &root: rootBoards)
+        workers[0].boards[0].insert(root);
+
+    std::atomic<int> nextRoot(0);
+    auto work = [&](Worker &worker) {
+        TRACE_ZONE("Perft::walk");
+        int i;
+        while ((i = nextRoot++) < (int)rootBoards.size())
+            if (depth > 1)
+                walk(worker, rootBoards[i], 1);
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; t++)
+        pool.push_back(std::thread(work, std::ref(workers[t])));
+    work(workers[0]);
+    for (std::thread &thread: pool)
+        thread.join();
+
+    //Boards reached by more than one thread count once, the smaller sets are folded into the largest
+    for (int d = 0; d < depth; d++)
+    {
+        Worker *largest = &workers[0];
+        for (Worker &worker: workers)
+        {
+            if (d > 0)
+                levels[d].nodes += worker.nodes[d];
+            if (worker.boards[d].size() > largest->boards[d].size())
+                largest = &worker;
+        }
+        for (Worker &worker: workers)
+            if (&worker != largest)
+            {
+                largest->boards[d].merge(worker.boards[d]);
+                worker.boards[d].free();
+            }
+        levels[d].distinct = largest->boards[d].size();
+        largest->boards[d].free();
+    }
+    return levels;
+}
@@ -0,0 +1,446 @@
+#include <stdint.h>
+#include <string.h>
+
+#ifndef DEFS_H
+#include "defs.hpp"
+#endif
+
+#ifndef BOARD_H
+#include "board.hpp"
+#endif
+
+#ifndef SHAPE_H
+#include "shape.hpp"
+#endif
+
+#ifndef TRACE_H
+#include "trace.hpp"
+#endif
+
+#define PLACEMENT_H
+
+//Highest shape box row searched, kicks can lift a shape above the grid
+const int PLACEMENT_TOP = -SHAPE_BOX;
+
+//Shape box rows searched, from PLACEMENT_TOP to the bottom of the grid
+const int PLACEMENT_ROWS = GRID_HEIGHT - PLACEMENT_TOP;
+
+//Shape box columns searched, bit x + BOARD_WALL of a row mask stands for column x
+const int PLACEMENT_COLUMNS = GRID_WIDTH + BOARD_WALL;
+const uint32_t PLACEMENT_FIELD = (1u << PLACEMENT_COLUMNS) - 1;
+
+//Most lock positions one shape can have
+const int MAX_PLACEMENTS = ROTATION_TOTAL * PLACEMENT_ROWS * PLACEMENT_COLUMNS;
+
+static_assert(PLACEMENT_COLUMNS + SHAPE_BOX <= 32, "Placement rows must fit a 32 bit mask");
+
+//Where a shape can lock: the shape box position and the orientation it ends in
+struct Placement
+{
+    int8_t x;
+    int8_t y;
+    int8_t rotation;
+};
+
+//A fixed list of placements, so generating never touches the heap
+struct PlacementList
+{
+    int count;
+    Placement placements[MAX_PLACEMENTS];
+};
+
+//Lock a shape at a placement and clear lines the way GameCore does
+LineClear lockPlacement(Board &board, Shapes type, const Placement &p)
+{
+    board.place(getOrientation(type, p.rotation).mask, SHAPE_BOX, p.x, p.y, Colors(type));
+    return board.clearLines(p.y, SHAPE_BOX);
+}
+
+//Orientations that cover the same cells, like the two flat I_SHAPE rotations
+struct PlacementAlias
+{
+    //Lowest orientation with the same cells once both are moved to the top left of their boxes
+    int8_t canonical[SHAPE_TOTAL][ROTATION_TOTAL];
+
+    //Top left of the cells inside the shape box
+    Cell origin[SHAPE_TOTAL][ROTATION_TOTAL];
+};
+
+constexpr PlacementAlias buildPlacementAlias()
+{
+    PlacementAlias alias = {};
+    for (int shape = 0; shape < SHAPE_TOTAL; shape++)
+    {
+        for (int rot = 0; rot < ROTATION_TOTAL; rot++)
+        {
+            const Orientation &o = getOrientation(shape, rot);
+            int left = SHAPE_BOX, top = SHAPE_BOX;
+            for (int i = 0; i < 4; i++)
+            {
+                if (o.cells[i].x < left)
+                    left = o.cells[i].x;
+                if (o.cells[i].y < top)
+                    top = o.cells[i].y;
+            }
+            alias.origin[shape][rot].x = left;
+            alias.origin[shape][rot].y = top;
+
+            //Compare the masks moved to the top left corner
+            alias.canonical[shape][rot] = rot;
+            for (int other = 0; other < rot; other++)
+            {
+                const Orientation &p = getOrientation(shape, other);
+                const Cell &c = alias.origin[shape][other];
+                bool same = true;
+                for (int row = 0; row < SHAPE_BOX; row++)
+                {
+                    uint16_t a = row + top < SHAPE_BOX ? o.mask[row + top] >> left : 0;
+                    uint16_t b = row + c.y < SHAPE_BOX ? p.mask[row + c.y] >> c.x : 0;
+                    if (a != b)
+                        same = false;
+                }
+                if (same)
+                {
+                    alias.canonical[shape][rot] = other;
+                    break;
+                }
+            }
+        }
+    }
+    return alias;
+}
+
+constexpr PlacementAlias PLACEMENT_ALIAS = buildPlacementAlias();
+
+static_assert(PLACEMENT_ALIAS.canonical[I_SHAPE][2] == 0 && PLACEMENT_ALIAS.canonical[I_SHAPE][3] == 1, "I_SHAPE has two distinct orientations");
+static_assert(PLACEMENT_ALIAS.canonical[T_SHAPE][2] == 2, "T_SHAPE has four distinct orientations");
+
+//Kicks that move a shape up or down only follow a kick with the same sideways offset,
+//so in rows that touch nothing but the walls every rotation stays in its row
+constexpr bool checkKickRows()
+{
+    for (int shape = 0; shape < SHAPE_TOTAL; shape++)
+        for (int rot = 0; rot < ROTATION_TOTAL; rot++)
+        {
+            const Orientation &o = getOrientation(shape, rot);
+            for (int k = 0; k < KICK_TOTAL; k++)
+            {
+                if (o.kicks[k].y == 0)
+                    continue;
+                bool tried = false;
+                for (int j = 0; j < k; j++)
+                    if (o.kicks[j].x == o.kicks[k].x && o.kicks[j].y == 0)
+                        tried = true;
+                if (!tried)
+                    return false;
+            }
+        }
+    return true;
+}
+
+static_assert(checkKickRows(), "Open rows are searched as one, which needs every vertical kick to repeat an earlier sideways one");
+
+//Spread seeds both ways through a row mask, the seeds must be inside it
+inline uint32_t spreadRow(uint32_t seeds, uint32_t pass)
+{
+    uint32_t left = seeds, right = seeds;
+    uint32_t passLeft = pass, passRight = pass;
+    for (int shift = 1; shift < PLACEMENT_COLUMNS; shift <<= 1)
+    {
+        left |= passLeft & (left >> shift);
+        right |= passRight & (right << shift);
+        passLeft &= passLeft >> shift;
+        passRight &= passRight << shift;
+    }
+    return left | right;
+}
+
+//Finds every position a shape can lock in with the game's own moves
+//Each step applies one move, so every state on a path is one the shape rests in between steps,
+//and a state with the stack right under it is final since the game locks it there
+class PlacementGenerator
+{
+    public:
+        //Constructor
+        PlacementGenerator();
+
+        //Search from the shape where it is and list every distinct lock position
+        int generate(const Board &board, const Shape &shape, PlacementList &out);
+
+        //Check if the last search reached a state
+        bool isReachable(int x, int y, int rotation) const;
+
+    private:
+        //Mark where each orientation fits and where it would lock
+        void buildMasks(const Board &board, Shapes type);
+
+        //Reach everything the rows above the stack allow in one go, they all behave the same
+        void searchOpenRows(Shapes type, int rotation, uint32_t start, int row);
+
+        //Spread the reached states until nothing changes
+        void search(Shapes type);
+
+        //Collect the lock positions, skipping orientations that cover the same cells as one already listed
+        void collect(Shapes type, PlacementList &out) const;
+
+        //Positions where an orientation fits, one row mask per shape box row
+        uint32_t fits[ROTATION_TOTAL][PLACEMENT_ROWS];
+
+        //Positions that fit with the stack right below
+        uint32_t settled[ROTATION_TOTAL][PLACEMENT_ROWS];
+
+        //Positions reached from the start
+        uint32_t reached[ROTATION_TOTAL][PLACEMENT_ROWS];
+
+        //Reached positions whose moves were already followed
+        uint32_t expanded[ROTATION_TOTAL][PLACEMENT_ROWS];
+
+        //Leading shape box rows that only touch empty rows, and where each orientation fits in them
+        int openRows;
+        uint32_t openFits[ROTATION_TOTAL];
+};
+
+PlacementGenerator::PlacementGenerator()
+{
+    memset(fits, 0, sizeof(fits));
+    memset(settled, 0, sizeof(settled));
+    memset(reached, 0, sizeof(reached));
+    memset(expanded, 0, sizeof(expanded));
+    memset(openFits, 0, sizeof(openFits));
+    openRows = 0;
+}
+
+void PlacementGenerator::buildMasks(const Board &board, Shapes type)
+{
+    //A shape box row is open when all of its rows are above the stack and inside the grid
+    int top = 0;
+    while (top < GRID_HEIGHT && board.getRow(top) == 0)
+        top++;
+    openRows = top - PLACEMENT_TOP - SHAPE_BOX + 1;
+    if (openRows < 0)
+        openRows = 0;
+
+    //Rows of the padded board below the open ones, rows above the grid are open and rows below are solid
+    uint32_t padded[PLACEMENT_ROWS + SHAPE_BOX];
+    for (int i = openRows; i < PLACEMENT_ROWS + SHAPE_BOX; i++)
+        padded[i] = board.paddedRow(PLACEMENT_TOP + i);
+
+    for (int rot = 0; rot < ROTATION_TOTAL; rot++)
+    {
+        //A cell at (cx, cy) in the box is blocked at box column x when padded bit x + cx of row y + cy is set
+        const Orientation &o = getOrientation(type, rot);
+        uint32_t walls = 0;
+        for (int i = 0; i < 4; i++)
+            walls |= BOARD_WALLS >> o.cells[i].x;
+        openFits[rot] = ~walls & PLACEMENT_FIELD;
+
+        for (int y = 0; y < openRows; y++)
+            fits[rot][y] = openFits[rot];
+        for (int y = openRows; y < PLACEMENT_ROWS; y++)
+        {
+            uint32_t blocked = 0;
+            for (int i = 0; i < 4; i++)
+                blocked |= padded[y + o.cells[i].y] >> o.cells[i].x;
+            fits[rot][y] = ~blocked & PLACEMENT_FIELD;
+        }
+
+        int first = openRows > 0 ? openRows - 1 : 0;
+        for (int y = 0; y < first; y++)
+            settled[rot][y] = 0;
+        for (int y = first; y < PLACEMENT_ROWS; y++)
+            settled[rot][y] = fits[rot][y] & ~(y + 1 < PLACEMENT_ROWS ? fits[rot][y + 1] : 0);
+    }
+}
+
+void PlacementGenerator::searchOpenRows(Shapes type, int rotation, uint32_t start, int row)
+{
+    //Nothing locks and no kick changes the row, so a state reached in one open row is reached in every one below it
+    uint32_t open[ROTATION_TOTAL] = {0};
+    open[rotation] = start;
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (int rot = 0; rot < ROTATION_TOTAL; rot++)
+        {
+            if (open[rot] == 0)
+                continue;
+            open[rot] = spreadRow(open[rot], openFits[rot]);
+            if (type == SQR_SHAPE)
+                continue;
+
+            int next = (rot + 1) % ROTATION_TOTAL;
+            const Orientation &o = getOrientation(type, rot);
+            uint32_t remaining = open[rot];
+            for (int k = 0; k < KICK_TOTAL && remaining; k++)
+            {
+                int kx = o.kicks[k].x;
+                uint32_t moved = kx >= 0 ? remaining << kx : remaining >> -kx;
+                uint32_t landed = moved & openFits[next];
+                if (landed & ~open[next])
+                {
+                    open[next] |= landed;
+                    changed = true;
+                }
+                remaining &= ~(kx >= 0 ? landed >> kx : landed << -kx);
+            }
+        }
+    }
+
+    //The last open row is left for the search, it is where the shape meets the stack
+    for (int rot = 0; rot < ROTATION_TOTAL; rot++)
+    {
+        for (int y = row; y < openRows - 1; y++)
+        {
+            reached[rot][y] = open[rot];
+            expanded[rot][y] = open[rot];
+        }
+        reached[rot][openRows - 1] = open[rot];
+    }
+}
+
+void PlacementGenerator::search(Shapes type)
+{
+    bool rotates = type != SQR_SHAPE;
+
+    //Rows with states not yet expanded, bit y for shape box row y
+    uint64_t dirty[ROTATION_TOTAL] = {0};
+    for (int rot = 0; rot < ROTATION_TOTAL; rot++)
+        for (int y = 0; y < PLACEMENT_ROWS; y++)
+            if (reached[rot][y] & ~expanded[rot][y])
+                dirty[rot] |= 1ull << y;
+
+    while (dirty[0] | dirty[1] | dirty[2] | dirty[3])
+    {
+        for (int rot = 0; rot < ROTATION_TOTAL; rot++)
+        {
+            int next = (rot + 1) % ROTATION_TOTAL;
+            const Orientation &o = getOrientation(type, rot);
+
+            //Lowest row first, so falling states are picked up in the same sweep
+            while (dirty[rot])
+            {
+                int y = __builtin_ctzll(dirty[rot]);
+                dirty[rot] &= dirty[rot] - 1;
+
+                //Slide sideways through the states that do not lock, a locking neighbour is reached but goes no further
+                uint32_t fit = fits[rot][y];
+                uint32_t open = fit & ~settled[rot][y];
+                uint32_t slid = spreadRow(reached[rot][y] & open & ~expanded[rot][y], open);
+                uint32_t row = reached[rot][y] | slid | (((slid >> 1) | (slid << 1)) & fit);
+                reached[rot][y] = row;
+
+                //Expand only the states new to this row
+                uint32_t fresh = row & ~expanded[rot][y];
+                expanded[rot][y] |= fresh;
+                uint32_t live = fresh & open;
+                if (live == 0)
+                    continue;
+
+                //Fall one row, the row below fits wherever the shape has not locked
+                if (y + 1 < PLACEMENT_ROWS && (live & ~reached[rot][y + 1]))
+                {
+                    reached[rot][y + 1] |= live;
+                    dirty[rot] |= 1ull << (y + 1);
+                }
+
+                //Rotate clockwise, each state takes the first kick that fits
+                if (!rotates)
+                    continue;
+                uint32_t remaining = live;
+                for (int k = 0; k < KICK_TOTAL && remaining; k++)
+                {
+                    int kx = o.kicks[k].x;
+                    int ky = y + o.kicks[k].y;
+
+                    //Kicks past the top of the search are dropped rather than tracked
+                    if (ky < 0)
+                        break;
+                    if (ky >= PLACEMENT_ROWS)
+                        continue;
+
+                    uint32_t moved = kx >= 0 ? remaining << kx : remaining >> -kx;
+                    uint32_t landed = moved & fits[next][ky];
+                    if (landed & ~reached[next][ky])
+                    {
+                        reached[next][ky] |= landed;
+                        dirty[next] |= 1ull << ky;
+                    }
+                    remaining &= ~(kx >= 0 ? landed >> kx : landed << -kx);
+                }
+            }
+        }
+    }
+}
+
+void PlacementGenerator::collect(Shapes type, PlacementList &out) const
+{
+    out.count = 0;
+    for (int rot = 0; rot < ROTATION_TOTAL; rot++)
+    {
+        int canonical = PLACEMENT_ALIAS.canonical[type][rot];
+        int dx = PLACEMENT_ALIAS.origin[type][rot].x - PLACEMENT_ALIAS.origin[type][canonical].x;
+        int dy = PLACEMENT_ALIAS.origin[type][rot].y - PLACEMENT_ALIAS.origin[type][canonical].y;
+
+        //Nothing locks above the last open row
+        for (int y = openRows > 0 ? openRows - 1 : 0; y < PLACEMENT_ROWS; y++)
+        {
+            uint32_t row = reached[rot][y] & settled[rot][y];
+
+            //The same cells were already listed from the canonical orientation
+            if (canonical != rot && y + dy >= 0 && y + dy < PLACEMENT_ROWS)
+            {
+                uint32_t seen = reached[canonical][y + dy] & settled[canonical][y + dy];
+                row &= ~(dx >= 0 ? seen >> dx : seen << -dx);
+            }
+
+            while (row)
+            {
+                int bit = __builtin_ctz(row);
+                row &= row - 1;
+                Placement &p = out.placements[out.count++];
+                p.x = bit - BOARD_WALL;
+                p.y = y + PLACEMENT_TOP;
+                p.rotation = rot;
+            }
+        }
+    }
+}
+
+int PlacementGenerator::generate(const Board &board, const Shape &shape, PlacementList &out)
+{
+    TRACE_ZONE("PlacementGenerator::generate");
+    Shapes type = shape.getType();
+    buildMasks(board, type);
+    memset(reached, 0, sizeof(reached));
+    memset(expanded, 0, sizeof(expanded));
+
+    int x, y;
+    shape.getRelativePosition(x, y);
+    int row = y - PLACEMENT_TOP;
+    int rotation = shape.getRotation();
+    out.count = 0;
+    if (row < 0 || row >= PLACEMENT_ROWS || x < -BOARD_WALL || x >= GRID_WIDTH)
+        return 0;
+
+    //A shape that does not fit where it is has nowhere to go
+    uint32_t start = 1u << (x + BOARD_WALL);
+    if (!(fits[rotation][row] & start))
+        return 0;
+
+    if (row < openRows - 1)
+        searchOpenRows(type, rotation, start, row);
+    else
+        reached[rotation][row] = start;
+    search(type);
+    collect(type, out);
+    return out.count;
+}
+
+bool PlacementGenerator::isReachable(int x, int y, int rotation) const
+{
+    int row = y - PLACEMENT_TOP;
+    if (row < 0 || row >= PLACEMENT_ROWS || x < -BOARD_WALL || x >= GRID_WIDTH)
+        return false;
+    return (reached[rotation][row] >> (x + BOARD_WALL)) & 1;
+}
@@ -0,0 +1,223 @@
+#include <stdint.h>
+
+#ifndef DEFS_H
+#include "defs.hpp"
+#endif
+
+#ifndef SERIAL_H
+#include "serial.hpp"
+#endif
+
+#define RANDOM_H
+
+//xoshiro128** generator, 16 bytes of state and the same sequence on every platform
+class Random
+{
+    public:
+        //Constructor
+        Random(uint32_t seed = 1);
+
+        //Restart the sequence from a seed
+        void seed(uint32_t seed);
+
+        //Get the next 32 random bits
+        uint32_t next();
+
+        //Get an unbiased number in [0, bound)
+        uint32_t below(uint32_t bound);
+
+        //Append the generator state
+        void writeState(StateWriter &out) const;
+
+        //Restore a state written by writeState
+        void readState(StateReader &in);
+
+    private:
+        //Generator state
+        uint32_t s[4];
+};
+
+Random::Random(uint32_t seed)
+{
+    this->seed(seed);
+}
+
+void Random::seed(uint32_t seed)
+{
+    //Expand the seed with splitmix64 so similar seeds give unrelated states
+    uint64_t x = seed;
+    for (int i = 0; i < 4; i += 2)
+    {
+        x += 0x9E3779B97F4A7C15ull;
+        uint64_t z = x;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        z ^= z >> 31;
+        s[i] = (uint32_t)z;
+        s[i + 1] = (uint32_t)(z >> 32);
+    }
+}
+
+uint32_t Random::next()
+{
+    uint32_t result = s[1] * 5;
+    result = ((result << 7) | (result >> 25)) * 9;
+    uint32_t t = s[1] << 9;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = (s[3] << 11) | (s[3] >> 21);
+    return result;
+}
+
+uint32_t Random::below(uint32_t bound)
+{
+    //Lemire's multiply and reject, exact for any bound
+    uint64_t m = (uint64_t)next() * bound;
+    uint32_t low = (uint32_t)m;
+    if (low < bound)
+    {
+        uint32_t threshold = -bound % bound;
+        while (low < threshold)
+        {
+            m = (uint64_t)next() * bound;
+            low = (uint32_t)m;
+        }
+    }
+    return (uint32_t)(m >> 32);
+}
+
+void Random::writeState(StateWriter &out) const
+{
+    for (int i = 0; i < 4; i++)
+        out.u32(s[i]);
+}
+
+void Random::readState(StateReader &in)
+{
+    for (int i = 0; i < 4; i++)
+        s[i] = in.u32();
+}
+
+//Capacity of the upcoming shape ring, a power of two
+const int BAG_QUEUE = 16;
+
+//Shapes that can always be peeked after the current one
+const int BAG_LOOKAHEAD = BAG_QUEUE - SHAPE_TOTAL;
+
+//Deals every shape once per bag of seven, in a shuffled order
+class ShapeBag
+{
+    public:
+        //Constructor
+        ShapeBag(uint32_t seed = 1);
+
+        //Restart from a seed
+        void reset(uint32_t seed);
+
+        //Take the next shape
+        Shapes next();
+
+        //Look at an upcoming shape, 0 is the one next() returns
+        Shapes peek(int i) const;
+
+        //Append the generator and the queued shapes
+        void writeState(StateWriter &out) const;
+
+        //Restore a state written by writeState, false if the queue is too long or holds a bad shape
+        bool readState(StateReader &in);
+
+    private:
+        //Append shuffled bags while there is room for a whole one
+        void refill();
+
+        //Shuffle source
+        Random random;
+
+        //Ring of upcoming shapes
+        uint8_t queue[BAG_QUEUE];
+
+        //Position of the next shape and number queued
+        uint8_t head;
+        uint8_t count;
+};
+
+static_assert((BAG_QUEUE & (BAG_QUEUE - 1)) == 0, "BAG_QUEUE must be a power of two");
+static_assert(BAG_LOOKAHEAD > 0, "BAG_QUEUE must hold more than one bag");
+
+ShapeBag::ShapeBag(uint32_t seed)
+{
+    reset(seed);
+}
+
+void ShapeBag::reset(uint32_t seed)
+{
+    random.seed(seed);
+    head = 0;
+    count = 0;
+    refill();
+}
+
+void ShapeBag::refill()
+{
+    while (count + SHAPE_TOTAL <= BAG_QUEUE)
+    {
+        uint8_t bag[SHAPE_TOTAL];
+        for (int i = 0; i < SHAPE_TOTAL; i++)
+            bag[i] = i;
+
+        //Fisher-Yates shuffle
+        for (int i = SHAPE_TOTAL - 1; i > 0; i--)
+        {
+            int j = random.below(i + 1);
+            uint8_t t = bag[i];
+            bag[i] = bag[j];
+            bag[j] = t;
+        }
+
+        for (int i = 0; i < SHAPE_TOTAL; i++)
+            queue[(head + count++) & (BAG_QUEUE - 1)] = bag[i];
+    }
+}
+
+Shapes ShapeBag::next()
+{
+    Shapes shape = Shapes(queue[head]);
+    head = (head + 1) & (BAG_QUEUE - 1);
+    count--;
+    refill();
+    return shape;
+}
+
+Shapes ShapeBag::peek(int i) const
+{
+    return Shapes(queue[(head + i) & (BAG_QUEUE - 1)]);
+}
+
+void ShapeBag::writeState(StateWriter &out) const
+{
+    //The ring is stored from its head so the restored one starts at 0
+    random.writeState(out);
+    out.u8(count);
+    for (int i = 0; i < count; i++)
+        out.u8(queue[(head + i) & (BAG_QUEUE - 1)]);
+}
+
+bool ShapeBag::readState(StateReader &in)
+{
+    random.readState(in);
+    head = 0;
+    count = in.u8();
+    if (count > BAG_QUEUE)
+        return false;
+    for (int i = 0; i < count; i++)
+    {
+        queue[i] = in.u8();
+        if (queue[i] >= SHAPE_TOTAL)
+            return false;
+    }
+    return true;
+}
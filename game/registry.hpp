@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+
+#ifndef TRACE_H
+#include "trace.hpp"
+#endif
+
+#ifndef BUNDLE_H
+#include "bundle.hpp"
+#endif
+
+#define REGISTRY_H
+
+//An asset compiled into the executable
+struct EmbeddedAsset
+{
+    const char *name;
+    const unsigned char *data;
+    size_t size;
+};
+
+//Built with -DEMBED_ASSETS after make embed has generated the arrays
+#ifdef EMBED_ASSETS
+#include "embedded_assets.hpp"
+#endif
+
+//Resolves logical asset names, the paths under Assets/, to image data
+//Embedded data wins, then the bundle, then the file next to the working directory, then the file next to the executable
+class AssetRegistry
+{
+    public:
+        //Constructor
+        AssetRegistry();
+
+        //Look up the executable folder and map a bundle, call on the main thread before loading anything
+        bool openBundle(std::string path);
+
+        //Find an asset compiled into the executable, NULL if there is none
+        const EmbeddedAsset *findEmbedded(const std::string &name) const;
+
+        //Get the surface of an image, the caller frees it, safe to call from any thread once set up
+        SDL_Surface *loadSurface(std::string name) const;
+
+    private:
+        //Decoded images
+        AssetBundle bundle;
+
+        //Folder of the executable, for names that do not resolve from the working directory
+        std::string basePath;
+};
+
+AssetRegistry::AssetRegistry()
+{
+}
+
+bool AssetRegistry::openBundle(std::string path)
+{
+    char *base = SDL_GetBasePath();
+    if (base != NULL)
+    {
+        basePath = base;
+        SDL_free(base);
+    }
+
+    if (bundle.open(path))
+        return true;
+    return !basePath.empty() && bundle.open(basePath + path);
+}
+
+const EmbeddedAsset *AssetRegistry::findEmbedded(const std::string &name) const
+{
+#ifdef EMBED_ASSETS
+    for (int i = 0; i < EMBEDDED_ASSET_COUNT; i++)
+        if (name == EMBEDDED_ASSETS[i].name)
+            return &EMBEDDED_ASSETS[i];
+#else
+    //Nothing is compiled in to look the name up against
+    (void)name;
+#endif
+    return NULL;
+}
+
+SDL_Surface *AssetRegistry::loadSurface(std::string name) const
+{
+    TRACE_ZONE("AssetRegistry::loadSurface");
+    const EmbeddedAsset *embedded = findEmbedded(name);
+    if (embedded != NULL)
+        return IMG_Load_RW(SDL_RWFromConstMem(embedded->data, (int)embedded->size), 1);
+
+    const BundleEntry *entry = bundle.find(name);
+    if (entry != NULL)
+        return bundle.createSurface(entry);
+
+    SDL_Surface *surface = IMG_Load(name.c_str());
+    if (surface == NULL && !basePath.empty())
+        surface = IMG_Load((basePath + name).c_str());
+    if (surface == NULL)
+        printf("Unable to load image %s! SDL Error: %s\n", name.c_str(), IMG_GetError());
+    return surface;
+}
+
+//Every image the game loads goes through here
+AssetRegistry gAssets;
+
+//Get the surface of an image by logical name, the caller frees it
+SDL_Surface *loadSurface(std::string name)
+{
+    return gAssets.loadSurface(name);
+}
@@ -0,0 +1,536 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+#include <string>
+
+#ifndef CORE_H
+#include "core.hpp"
+#endif
+
+#ifndef TRACE_H
+#include "trace.hpp"
+#endif
+
+#define REPLAY_H
+
+//Replay files start with these bytes followed by a version
+const char REPLAY_MAGIC[4] = {'T', 'M', 'R', 'P'};
+//Version 2 appends keyframes and their index after the records, version 1 files are still read
+const uint8_t REPLAY_VERSION = 2;
+
+//Bytes before the records: magic, version and seed
+const size_t REPLAY_HEADER = 9;
+
+//Version 2 files end with these bytes after the sizes of the sections
+const char KEYFRAME_MAGIC[4] = {'T', 'M', 'K', 'F'};
+
+//Bytes of the trailer: record bytes, state bytes, keyframe count and magic
+const size_t KEYFRAME_TRAILER = 16;
+
+//Bytes of one index entry
+const size_t KEYFRAME_ENTRY = 20;
+
+//Shapes dealt between keyframes
+const int KEYFRAME_PIECES = 256;
+
+//Most bytes one serialized GameCore takes, a full board included
+const size_t KEYFRAME_STATE_MAX = 640;
+
+//Keyframes and state bytes reserved up front, reserveAhead doubles them when a game outgrows them
+const size_t KEYFRAME_RESERVE = 64;
+const size_t KEYFRAME_STATE_RESERVE = KEYFRAME_RESERVE * KEYFRAME_STATE_MAX;
+
+//Action codes stored in the low 3 bits of every record
+enum ReplayAction
+{
+    ACTION_LEFT,
+    ACTION_RIGHT,
+    ACTION_DOWN,
+    ACTION_ROTATE,
+    ACTION_HARDDROP,
+    ACTION_TOTAL,
+    ACTION_END = 7
+};
+
+//Bytes reserved up front, as many shapes as the keyframes cover at 8 key presses each
+//The bot presses more than that, so long games rely on reserveAhead
+const size_t REPLAY_RESERVE = KEYFRAME_RESERVE * KEYFRAME_PIECES * 8;
+
+//Most bytes one step can record, every action with a delta of up to 32 bits
+const size_t REPLAY_STEP_MAX = ACTION_TOTAL * 5;
+
+//Bits of a record that hold the action
+const int ACTION_BITS = 3;
+
+//Input flag of every action code that maps to one
+const uint8_t ACTION_INPUTS[ACTION_TOTAL] = {INPUT_LEFT, INPUT_RIGHT, INPUT_DOWN, INPUT_ROTATE, INPUT_HARDDROP};
+
+//A point playback can resume from without simulating the steps before it
+struct Keyframe
+{
+    //Steps simulated when the state was taken
+    uint32_t step;
+
+    //Record stream position: byte offset and step of the last record before it
+    uint32_t recordOffset;
+    uint32_t lastRecord;
+
+    //Serialized GameCore inside the state section
+    uint32_t stateOffset;
+    uint32_t stateSize;
+};
+
+//A recorded game: the seed and every input the simulation consumed
+//Each record is a varint of (steps since the previous record << 3 | action)
+class Replay
+{
+    public:
+        //Constructor
+        Replay();
+
+        //Start recording a game
+        void begin(uint32_t seed);
+
+        //Make room for the records of that many steps and one keyframe, doubling the buffers if needed
+        //Call it where the heap is allowed so that record and checkpoint never allocate
+        void reserveAhead(uint32_t steps);
+
+        //Record the inputs consumed by one simulation step
+        void record(uint8_t inputs);
+
+        //Close the record stream
+        void finish();
+
+        //Get the seed of the game
+        uint32_t getSeed() const;
+
+        //Get the encoded records
+        const std::vector<uint8_t> &getData() const;
+
+        //Get the number of simulation steps in the game
+        uint32_t getSteps() const;
+
+        //Write the replay to a file
+        bool save(std::string path) const;
+
+        //Read a replay from a file
+        bool load(std::string path);
+
+        //Rewind playback to the first step
+        void rewind();
+
+        //Get the inputs of the next step and advance
+        uint8_t next();
+
+        //Check if playback reached the end of the game
+        bool done() const;
+
+        //Store a keyframe once enough shapes were dealt since the last one, call after every recorded step
+        void checkpoint(const GameCore &core);
+
+        //Get the number of keyframes
+        size_t getKeyframes() const;
+
+        //Get the step playback will run next
+        uint32_t getPlayStep() const;
+
+        //Bring core and playback to a step through the nearest keyframe, returns the steps simulated
+        uint32_t seek(GameCore &core, uint32_t step);
+
+    private:
+        //Append a record
+        void writeRecord(uint32_t delta, int action);
+
+        //Decode the record under the read cursor, false and the end of playback if it is malformed
+        bool readRecord();
+
+        //Decode every record once, false if one is malformed
+        bool checkRecords();
+
+        //Parse the keyframe sections of a version 2 file
+        bool readKeyframes(const std::vector<uint8_t> &file);
+
+        //Resume playback from a keyframe
+        bool restore(GameCore &core, const Keyframe &keyframe);
+
+        //Seed of the game
+        uint32_t seed;
+
+        //Encoded records
+        std::vector<uint8_t> data;
+
+        //Steps recorded, and the step of the last record written
+        uint32_t steps;
+        uint32_t lastRecord;
+
+        //Flag set once the end record is written
+        bool finished;
+
+        //Keyframes in step order and their serialized states
+        std::vector<Keyframe> keyframes;
+        std::vector<uint8_t> states;
+
+        //Shape count that triggers the next keyframe
+        int nextKeyframe;
+
+        //Playback cursor: byte offset, step reached and step of the pending record
+        size_t cursor;
+        uint32_t playStep;
+        uint32_t pendingStep;
+        int pendingAction;
+};
+
+Replay::Replay()
+{
+    begin(0);
+}
+
+void Replay::begin(uint32_t seed)
+{
+    this->seed = seed;
+    data.clear();
+    data.reserve(REPLAY_RESERVE);
+    steps = 0;
+    lastRecord = 0;
+    finished = false;
+    keyframes.clear();
+    keyframes.reserve(KEYFRAME_RESERVE);
+    states.clear();
+    states.reserve(KEYFRAME_STATE_RESERVE);
+    nextKeyframe = KEYFRAME_PIECES;
+    rewind();
+}
+
+void Replay::reserveAhead(uint32_t steps)
+{
+    if (finished)
+        return;
+
+    size_t bytes = (size_t)steps * REPLAY_STEP_MAX;
+    if (data.capacity() - data.size() < bytes)
+        data.reserve(std::max(data.capacity() * 2, data.size() + bytes));
+    if (keyframes.size() == keyframes.capacity())
+        keyframes.reserve(keyframes.capacity() * 2 + 1);
+    if (states.capacity() - states.size() < KEYFRAME_STATE_MAX)
+        states.reserve(std::max(states.capacity() * 2, states.size() + KEYFRAME_STATE_MAX));
+}
+
+void Replay::writeRecord(uint32_t delta, int action)
+{
+    uint64_t value = ((uint64_t)delta << ACTION_BITS) | action;
+    while (value >= 0x80)
+    {
+        data.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    data.push_back((uint8_t)value);
+}
+
+void Replay::record(uint8_t inputs)
+{
+    if (finished)
+        return;
+
+    for (int action = 0; action < ACTION_TOTAL; action++)
+    {
+        if (inputs & ACTION_INPUTS[action])
+        {
+            writeRecord(steps - lastRecord, action);
+            lastRecord = steps;
+        }
+    }
+    steps++;
+}
+
+void Replay::finish()
+{
+    if (finished)
+        return;
+
+    writeRecord(steps - lastRecord, ACTION_END);
+    lastRecord = steps;
+    finished = true;
+}
+
+uint32_t Replay::getSeed() const
+{
+    return seed;
+}
+
+const std::vector<uint8_t> &Replay::getData() const
+{
+    return data;
+}
+
+uint32_t Replay::getSteps() const
+{
+    return steps;
+}
+
+bool Replay::save(std::string path) const
+{
+    TRACE_ZONE("Replay::save");
+    FILE *file = fopen(path.c_str(), "wb");
+    if (file == NULL)
+    {
+        printf("Unable to write replay %s!\n", path.c_str());
+        return false;
+    }
+
+    uint8_t header[REPLAY_HEADER];
+    for (int i = 0; i < 4; i++)
+        header[i] = REPLAY_MAGIC[i];
+    header[4] = REPLAY_VERSION;
+    for (int i = 0; i < 4; i++)
+        header[5 + i] = (uint8_t)(seed >> (8 * i));
+
+    //States, then the index, then the trailer a reader finds from the end of the file
+    std::vector<uint8_t> footer(states);
+    StateWriter out(footer);
+    for (const Keyframe &keyframe: keyframes)
+    {
+        out.u32(keyframe.step);
+        out.u32(keyframe.recordOffset);
+        out.u32(keyframe.lastRecord);
+        out.u32(keyframe.stateOffset);
+        out.u32(keyframe.stateSize);
+    }
+    out.u32(data.size());
+    out.u32(states.size());
+    out.u32(keyframes.size());
+    for (int i = 0; i < 4; i++)
+        out.u8(KEYFRAME_MAGIC[i]);
+
+    bool success = fwrite(header, 1, sizeof(header), file) == sizeof(header);
+    if (success && !data.empty())
+        success = fwrite(&data[0], 1, data.size(), file) == data.size();
+    if (success)
+        success = fwrite(&footer[0], 1, footer.size(), file) == footer.size();
+    fclose(file);
+    return success;
+}
+
+bool Replay::load(std::string path)
+{
+    TRACE_ZONE("Replay::load");
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == NULL)
+    {
+        printf("Unable to open replay %s!\n", path.c_str());
+        return false;
+    }
+
+    std::vector<uint8_t> contents;
+    uint8_t buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        contents.insert(contents.end(), buffer, buffer + read);
+    fclose(file);
+
+    const uint8_t *header = contents.empty() ? NULL : &contents[0];
+    if (contents.size() < REPLAY_HEADER || header[0] != REPLAY_MAGIC[0] || header[1] != REPLAY_MAGIC[1] ||
+        header[2] != REPLAY_MAGIC[2] || header[3] != REPLAY_MAGIC[3] || header[4] < 1 || header[4] > REPLAY_VERSION)
+    {
+        printf("%s is not a replay!\n", path.c_str());
+        return false;
+    }
+
+    begin(header[5] | (header[6] << 8) | (header[7] << 16) | ((uint32_t)header[8] << 24));
+    if (header[4] == 1)
+        data.assign(contents.begin() + REPLAY_HEADER, contents.end());
+    else if (!readKeyframes(contents))
+    {
+        printf("%s has a damaged keyframe index!\n", path.c_str());
+        begin(0);
+        return false;
+    }
+    if (!checkRecords())
+    {
+        printf("%s has a damaged record!\n", path.c_str());
+        begin(0);
+        return false;
+    }
+
+    finished = true;
+    rewind();
+    return true;
+}
+
+bool Replay::readKeyframes(const std::vector<uint8_t> &file)
+{
+    if (file.size() < REPLAY_HEADER + KEYFRAME_TRAILER)
+        return false;
+
+    size_t end = file.size() - KEYFRAME_TRAILER;
+    StateReader trailer(&file[end], KEYFRAME_TRAILER);
+    uint64_t recordBytes = trailer.u32();
+    uint64_t stateBytes = trailer.u32();
+    uint64_t count = trailer.u32();
+    for (int i = 0; i < 4; i++)
+        if (trailer.u8() != (uint8_t)KEYFRAME_MAGIC[i])
+            return false;
+    if (REPLAY_HEADER + recordBytes + stateBytes + count * KEYFRAME_ENTRY != end)
+        return false;
+
+    const uint8_t *records = &file[REPLAY_HEADER];
+    data.assign(records, records + recordBytes);
+    states.assign(records + recordBytes, records + recordBytes + stateBytes);
+
+    StateReader index(records + recordBytes + stateBytes, count * KEYFRAME_ENTRY);
+    keyframes.resize(count);
+    for (Keyframe &keyframe: keyframes)
+    {
+        keyframe.step = index.u32();
+        keyframe.recordOffset = index.u32();
+        keyframe.lastRecord = index.u32();
+        keyframe.stateOffset = index.u32();
+        keyframe.stateSize = index.u32();
+        if (keyframe.recordOffset > recordBytes || keyframe.stateSize == 0 || (uint64_t)keyframe.stateOffset + keyframe.stateSize > stateBytes)
+            return false;
+    }
+
+    //Seeking binary searches the steps
+    for (size_t i = 1; i < keyframes.size(); i++)
+        if (keyframes[i].step < keyframes[i - 1].step)
+            return false;
+    return true;
+}
+
+bool Replay::readRecord()
+{
+    pendingAction = ACTION_END;
+    if (cursor >= data.size())
+        return true;
+
+    //A varint cut short, longer than 63 bits or with a delta past 32 bits was never written by record
+    uint64_t value = 0;
+    for (int shift = 0;; shift += 7)
+    {
+        if (shift >= 63 || cursor >= data.size())
+            return false;
+        uint8_t byte = data[cursor++];
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            break;
+    }
+    if (value >> ACTION_BITS > UINT32_MAX)
+        return false;
+
+    pendingStep += (uint32_t)(value >> ACTION_BITS);
+    pendingAction = value & ((1 << ACTION_BITS) - 1);
+    return true;
+}
+
+bool Replay::checkRecords()
+{
+    cursor = 0;
+    pendingStep = 0;
+    do
+    {
+        if (!readRecord())
+            return false;
+    } while (pendingAction != ACTION_END);
+    return true;
+}
+
+void Replay::rewind()
+{
+    cursor = 0;
+    playStep = 0;
+    pendingStep = 0;
+    readRecord();
+}
+
+uint8_t Replay::next()
+{
+    uint8_t inputs = INPUT_NONE;
+    while (pendingAction != ACTION_END && pendingStep == playStep)
+    {
+        if (pendingAction < ACTION_TOTAL)
+            inputs |= ACTION_INPUTS[pendingAction];
+        readRecord();
+    }
+    playStep++;
+    return inputs;
+}
+
+bool Replay::done() const
+{
+    return pendingAction == ACTION_END && playStep >= pendingStep;
+}
+
+void Replay::checkpoint(const GameCore &core)
+{
+    if (finished || core.getPieces() < nextKeyframe)
+        return;
+    nextKeyframe = core.getPieces() + KEYFRAME_PIECES;
+
+    Keyframe keyframe;
+    keyframe.step = steps;
+    keyframe.recordOffset = data.size();
+    keyframe.lastRecord = lastRecord;
+    keyframe.stateOffset = states.size();
+    StateWriter out(states);
+    core.writeState(out);
+    keyframe.stateSize = states.size() - keyframe.stateOffset;
+    keyframes.push_back(keyframe);
+}
+
+size_t Replay::getKeyframes() const
+{
+    return keyframes.size();
+}
+
+uint32_t Replay::getPlayStep() const
+{
+    return playStep;
+}
+
+bool Replay::restore(GameCore &core, const Keyframe &keyframe)
+{
+    StateReader in(&states[keyframe.stateOffset], keyframe.stateSize);
+    if (!core.readState(in))
+        return false;
+
+    //The next record is decoded relative to the last one written before the keyframe
+    cursor = keyframe.recordOffset;
+    playStep = keyframe.step;
+    pendingStep = keyframe.lastRecord;
+    readRecord();
+    return true;
+}
+
+uint32_t Replay::seek(GameCore &core, uint32_t step)
+{
+    TRACE_ZONE("Replay::seek");
+    //Last keyframe at or before the target
+    size_t low = 0, high = keyframes.size();
+    while (low < high)
+    {
+        size_t middle = (low + high) / 2;
+        if (keyframes[middle].step <= step)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    uint32_t from = low > 0 ? keyframes[low - 1].step : 0;
+
+    //Jump unless playback is already between the keyframe and the target
+    if (playStep > step || playStep < from)
+    {
+        if (low == 0 || !restore(core, keyframes[low - 1]))
+        {
+            core.reset(seed);
+            rewind();
+        }
+    }
+
+    uint32_t simulated = 0;
+    while (playStep < step && !done() && !core.isOver())
+    {
+        core.step(next(), STEP_DT);
+        simulated++;
+    }
+    return simulated;
+}
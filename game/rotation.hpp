@@ -0,0 +1,162 @@
+#include <stdint.h>
+
+#ifndef DEFS_H
+#include "defs.hpp"
+#endif
+
+#define ROTATION_H
+
+//Side of the box holding a shape in every orientation
+const int SHAPE_BOX = 4;
+
+//Number of orientations of a shape
+const int ROTATION_TOTAL = 4;
+
+//Number of wall kick offsets tried per rotation
+const int KICK_TOTAL = 5;
+
+//A cell inside the shape box, y grows downwards like the grid
+struct Cell
+{
+    int8_t x, y;
+};
+
+//One orientation of a shape
+struct Orientation
+{
+    //Block cells inside the shape box
+    Cell cells[4];
+
+    //Occupancy mask of every row of the shape box
+    uint16_t mask[SHAPE_BOX];
+
+    //Offsets tried in order when rotating clockwise out of this orientation
+    Cell kicks[KICK_TOTAL];
+};
+
+struct ShapeTable
+{
+    Orientation orientations[SHAPE_TOTAL][ROTATION_TOTAL];
+};
+
+//Spawn cells of every shape
+constexpr Cell SPAWN_CELLS[SHAPE_TOTAL][4] = {
+    {{1, 0}, {2, 0}, {0, 1}, {1, 1}},   //S_SHAPE
+    {{0, 0}, {1, 0}, {1, 1}, {2, 1}},   //Z_SHAPE
+    {{1, 0}, {0, 1}, {1, 1}, {2, 1}},   //T_SHAPE
+    {{2, 0}, {0, 1}, {1, 1}, {2, 1}},   //L_SHAPE
+    {{0, 1}, {1, 1}, {2, 1}, {3, 1}},   //I_SHAPE
+    {{0, 0}, {0, 1}, {1, 1}, {2, 1}},   //ML_SHAPE
+    {{0, 0}, {1, 0}, {0, 1}, {1, 1}}    //SQR_SHAPE
+};
+
+//Side of the square each shape rotates inside
+constexpr int ROTATION_SIZE[SHAPE_TOTAL] = {3, 3, 3, 3, 4, 3, 2};
+
+//Clockwise wall kicks of the 3 wide shapes, indexed by the orientation rotated out of
+constexpr Cell KICKS_3[ROTATION_TOTAL][KICK_TOTAL] = {
+    {{0, 0}, {-1, 0}, {-1, -1}, {0, 2}, {-1, 2}},
+    {{0, 0}, {1, 0}, {1, 1}, {0, -2}, {1, -2}},
+    {{0, 0}, {1, 0}, {1, -1}, {0, 2}, {1, 2}},
+    {{0, 0}, {-1, 0}, {-1, 1}, {0, -2}, {-1, -2}}
+};
+
+//Clockwise wall kicks of I_SHAPE
+constexpr Cell KICKS_I[ROTATION_TOTAL][KICK_TOTAL] = {
+    {{0, 0}, {-2, 0}, {1, 0}, {-2, 1}, {1, -2}},
+    {{0, 0}, {-1, 0}, {2, 0}, {-1, -2}, {2, 1}},
+    {{0, 0}, {2, 0}, {-1, 0}, {2, -1}, {-1, 2}},
+    {{0, 0}, {1, 0}, {-2, 0}, {1, 2}, {-2, -1}}
+};
+
+constexpr ShapeTable buildShapeTable()
+{
+    ShapeTable table = {};
+    for (int shape = 0; shape < SHAPE_TOTAL; shape++)
+    {
+        int size = ROTATION_SIZE[shape];
+        for (int i = 0; i < 4; i++)
+            table.orientations[shape][0].cells[i] = SPAWN_CELLS[shape][i];
+
+        for (int rot = 0; rot < ROTATION_TOTAL; rot++)
+        {
+            Orientation &o = table.orientations[shape][rot];
+
+            //Rotate the previous orientation clockwise inside its square
+            if (rot > 0)
+            {
+                const Orientation &prev = table.orientations[shape][rot - 1];
+                for (int i = 0; i < 4; i++)
+                {
+                    o.cells[i].x = size - 1 - prev.cells[i].y;
+                    o.cells[i].y = prev.cells[i].x;
+                }
+            }
+
+            for (int i = 0; i < 4; i++)
+                o.mask[o.cells[i].y] |= 1u << o.cells[i].x;
+
+            for (int k = 0; k < KICK_TOTAL; k++)
+            {
+                if (shape == I_SHAPE)
+                    o.kicks[k] = KICKS_I[rot][k];
+                else if (shape != SQR_SHAPE)
+                    o.kicks[k] = KICKS_3[rot][k];
+            }
+        }
+    }
+    return table;
+}
+
+constexpr ShapeTable SHAPE_TABLE = buildShapeTable();
+
+//Get an orientation of a shape
+constexpr const Orientation &getOrientation(int shape, int rotation)
+{
+    return SHAPE_TABLE.orientations[shape][rotation];
+}
+
+constexpr int countBlocks(const Orientation &o)
+{
+    int total = 0;
+    for (int row = 0; row < SHAPE_BOX; row++)
+        for (int col = 0; col < SHAPE_BOX; col++)
+            total += (o.mask[row] >> col) & 1;
+    return total;
+}
+
+constexpr bool checkShapeTable()
+{
+    for (int shape = 0; shape < SHAPE_TOTAL; shape++)
+    {
+        for (int rot = 0; rot < ROTATION_TOTAL; rot++)
+        {
+            const Orientation &o = getOrientation(shape, rot);
+
+            //Four distinct blocks that stay inside the box
+            if (countBlocks(o) != 4)
+                return false;
+            for (int row = 0; row < SHAPE_BOX; row++)
+                if (o.mask[row] >> SHAPE_BOX)
+                    return false;
+
+            //The unkicked rotation is always tried first
+            if (o.kicks[0].x != 0 || o.kicks[0].y != 0)
+                return false;
+        }
+
+        //Four clockwise turns lead back to the spawn orientation
+        const Orientation &last = getOrientation(shape, ROTATION_TOTAL - 1);
+        int size = ROTATION_SIZE[shape];
+        for (int i = 0; i < 4; i++)
+            if (size - 1 - last.cells[i].y != SPAWN_CELLS[shape][i].x || last.cells[i].x != SPAWN_CELLS[shape][i].y)
+                return false;
+    }
+    return true;
+}
+
+static_assert(checkShapeTable(), "Shape table is malformed");
+static_assert(getOrientation(SQR_SHAPE, 1).mask[0] == getOrientation(SQR_SHAPE, 0).mask[0] &&
+              getOrientation(SQR_SHAPE, 1).mask[1] == getOrientation(SQR_SHAPE, 0).mask[1],
+              "SQR_SHAPE must not move when rotated");
+static_assert(getOrientation(I_SHAPE, 0).mask[1] == 0xF, "I_SHAPE spawns flat on its second row");
@@ -0,0 +1,134 @@
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#define SERIAL_H
+
+//Appends little endian values to a byte buffer
+class StateWriter
+{
+    public:
+        //Constructor
+        StateWriter(std::vector<uint8_t> &out);
+
+        //Append values
+        void u8(uint8_t value);
+        void u16(uint16_t value);
+        void u32(uint32_t value);
+        void u64(uint64_t value);
+        void f64(double value);
+
+    private:
+        //Destination buffer
+        std::vector<uint8_t> &out;
+};
+
+//Reads little endian values back, every read past the end returns 0 and clears ok()
+class StateReader
+{
+    public:
+        //Constructor
+        StateReader(const uint8_t *data, size_t size);
+
+        //Read values
+        uint8_t u8();
+        uint16_t u16();
+        uint32_t u32();
+        uint64_t u64();
+        double f64();
+
+        //Check if every read so far was inside the buffer
+        bool ok() const;
+
+    private:
+        //Source bytes and read position
+        const uint8_t *data;
+        size_t size;
+        size_t cursor;
+
+        //Flag cleared by a read past the end
+        bool valid;
+};
+
+StateWriter::StateWriter(std::vector<uint8_t> &out) : out(out)
+{
+}
+
+void StateWriter::u8(uint8_t value)
+{
+    out.push_back(value);
+}
+
+void StateWriter::u16(uint16_t value)
+{
+    u8((uint8_t)value);
+    u8((uint8_t)(value >> 8));
+}
+
+void StateWriter::u32(uint32_t value)
+{
+    u16((uint16_t)value);
+    u16((uint16_t)(value >> 16));
+}
+
+void StateWriter::u64(uint64_t value)
+{
+    u32((uint32_t)value);
+    u32((uint32_t)(value >> 32));
+}
+
+void StateWriter::f64(double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    u64(bits);
+}
+
+StateReader::StateReader(const uint8_t *data, size_t size)
+{
+    this->data = data;
+    this->size = size;
+    cursor = 0;
+    valid = true;
+}
+
+uint8_t StateReader::u8()
+{
+    if (cursor >= size)
+    {
+        valid = false;
+        return 0;
+    }
+    return data[cursor++];
+}
+
+uint16_t StateReader::u16()
+{
+    uint16_t low = u8();
+    return low | (uint16_t)(u8() << 8);
+}
+
+uint32_t StateReader::u32()
+{
+    uint32_t low = u16();
+    return low | ((uint32_t)u16() << 16);
+}
+
+uint64_t StateReader::u64()
+{
+    uint64_t low = u32();
+    return low | ((uint64_t)u32() << 32);
+}
+
+double StateReader::f64()
+{
+    uint64_t bits = u64();
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+bool StateReader::ok() const
+{
+    return valid;
+}
@@ -1,485 +1,251 @@
-#include <stdio.h>
-#include <SDL2/SDL.h>
-#include <SDL2/SDL_image.h>
-#include <vector>
-#include <cstdlib>
-#include <ctime>
-
-#ifndef TEXTURE_H
-#include "texture.hpp"
+#include <stdint.h>
+
+#ifndef DEFS_H
+#include "defs.hpp"
+#endif
+
+#ifndef BOARD_H
+#include "board.hpp"
 #endif
 
-#ifndef INIT_H
-#include "init.hpp"
+#ifndef ROTATION_H
+#include "rotation.hpp"
 #endif
 
-class Block
+#define SHAPE_H
+
+class Shape
 {
     public:
-        //Constructoe
-        Block();
 
-        //Copy constructor
-        Block(const Block &b);
+        //Constructor
+        Shape(Shapes type = S_SHAPE);
 
         //Destructor
-        ~Block();
+        ~Shape();
 
-        //Check if outside grid
-        bool checkGrid();
+        //Move down
+        void moveDown(const Board &board);
 
-        //Check if settled
-        bool checkSettled(int grid[GRID_HEIGHT][GRID_WIDTH]);
+        //Drop straight onto the stack
+        void hardDrop(const Board &board);
 
-        //Set relative position
-        void setCentrePosition(int x, int y);
+        //Get the rows the shape can fall before it lands
+        int dropDistance(const Board &board) const;
 
-        //Get centre position
-        void getCentrePosition(int &x, int &y);
+        //Move left
+        void moveLeft(const Board &board);
 
-        //Get offset position
-        void getOffsetPosition(int &x, int &y);
+        //Move right
+        void moveRight(const Board &board);
 
-        //Update offset
-        void updateOffset(int off_x, int off_y);
+        //Flip if possible
+        void flipAngle(const Board &board);
 
-        //Load from file
-        void loadFromFile(SDL_Renderer *gRenderer, std::string filepath);
+        //Rotate by pi/2
+        void rotateByPi2(const Board &board);
+
+        //Set relative position of the shape box
+        void setRelativePosition(int x, int y);
 
-        //Get grid position
-        void getGridPosition(int &x, int &y);
+        //Get relative position of the shape box
+        void getRelativePosition(int &x, int &y) const;
 
-        //Render
-        void render(SDL_Renderer *gRenderer, int grid_x, int grid_y);
+        //Get the shape type
+        Shapes getType() const;
+
+        //Get the shape color
+        Colors getColor() const;
+
+        //Get the current orientation
+        const Orientation &getOrientation() const;
+
+        //Get the orientation index
+        int getRotation() const;
+
+        //Check if settled
+        bool checkSettled(const Board &board) const;
+
+        //Check if the shape overlaps the board where it is
+        bool checkBlocked(const Board &board) const;
+
+        //Write the blocks into the board
+        void lock(Board &board) const;
+
+        //Append the type, orientation and position
+        void writeState(StateWriter &out) const;
+
+        //Restore a state written by writeState, false if the type, orientation or position is out of range
+        bool readState(StateReader &in);
 
     private:
-        //Centre point
+        //Move by a step if the board allows it
+        bool tryMove(const Board &board, int dx, int dy);
+
+        //Shape type
+        Shapes type;
+
+        //Color of the shape
+        Colors color;
+
+        //Relative position of the shape box
         int x, y;
 
-        //Offset values
-        int off_x, off_y;
+        //Orientation index into the shape table
+        int rotation;
 
-        //Texture
-        LTexture texture;
 };
 
-Block::Block()
+Shape::Shape(Shapes type)
 {
-    x = GRID_WIDTH/2;
-    y = 5;
+    //Set shape type
+    this->type = type;
 
-    off_x = 0;
-    off_y = 0;
-}
+    //Set shape color
+    color = Colors(type);
 
-Block::Block(const Block &b)
-{
-    x = b.x;
-    y = b.y;
-    off_x = b.off_x;
-    off_y = b.off_y;
-    texture = b.texture;
+    //Spawn centred at the top of the grid
+    rotation = 0;
+    setRelativePosition((GRID_WIDTH - ROTATION_SIZE[type]) / 2, 0);
 }
 
-Block::~Block()
-{
-    texture.free();
-    x = y = off_x = off_y = 0;
-}
-
-bool Block::checkGrid()
+Shape::~Shape()
 {
-    int gloc_x = x + off_x;
-    int gloc_y = y + off_y;
-
-    if (gloc_x >= 0 && gloc_x < GRID_WIDTH && gloc_y >= 0 && gloc_y < GRID_HEIGHT)
-        return true;
-
-    return false;
+    x = y = 0;
 }
 
-void Block::setCentrePosition(int x, int y)
+void Shape::setRelativePosition(int x, int y)
 {
     this->x = x;
     this->y = y;
 }
 
-void Block::getCentrePosition(int &x, int &y)
+void Shape::getRelativePosition(int &x, int &y) const
 {
     x = this->x;
     y = this->y;
 }
 
-void Block::getOffsetPosition(int &x, int &y)
-{
-    x = this->off_x;
-    y = this->off_y;
-}
-
-void Block::getGridPosition(int &x, int &y)
-{
-    x = this->x + off_x;
-    y = this->y + off_y;
-}
-
-void Block::updateOffset(int off_x, int off_y)
+Shapes Shape::getType() const
 {
-    this->off_x = off_x;
-    this->off_y = off_y;
+    return type;
 }
 
-void Block::loadFromFile(SDL_Renderer *gRenderer, std::string filepath)
+Colors Shape::getColor() const
 {
-    texture.loadFromFile(gRenderer, filepath);
+    return color;
 }
 
-void Block::render(SDL_Renderer *gRenderer, int grid_x, int grid_y)
+const Orientation &Shape::getOrientation() const
 {
-    texture.setPosition(grid_x + ((x+off_x) * texture.getWidth()), grid_y + ((y+off_y) * texture.getHeight()));
-    texture.render(gRenderer);
+    return ::getOrientation(type, rotation);
 }
 
-bool Block::checkSettled(int grid[GRID_HEIGHT][GRID_WIDTH])
+int Shape::getRotation() const
 {
-    int x, y;
-    getGridPosition(x, y);
-    
-    //Check if at the bottom
-    if (y == GRID_HEIGHT - 1)
-        return true;
-    
-    return false;
+    return rotation;
 }
 
-
-
-class Shape
-{
-    public:
-
-        //Constructor
-        Shape(SDL_Renderer *gRenderer, int shape_type = -1);
-
-        //Destructor
-        ~Shape();
-
-        //Move down
-        void moveDown();
-
-        //Move left
-        void moveLeft();
-
-        //Move right
-        void moveRight();
-
-        //Flip if possible
-        void flipAngle();
-
-        //Rotate by pi
-        void rotateByPi();
-
-        //Rotate by pi/2
-        void rotateByPi2();
-
-        //Set relative position
-        void setRelativePosition(int x, int y);
-
-        //Load from file
-        bool loadFromFile(SDL_Renderer *gRenderer);
-
-        //Get relative position
-        void getRelativePosition(int &x, int &y);
-
-        //Check if settled
-        bool checkSettled(int grid[GRID_HEIGHT][GRID_WIDTH]);
-
-        //Purge  blocks to renderqueue
-        void purgeBlocks(std::vector<Block> &renderQueue);
-
-        //Render
-        void render(SDL_Renderer *gRenderer, int grid_x, int grid_y);
-    
-    private:
-        //Shape type
-        Shapes type;
-
-        //Color of the shape
-        Colors color;
-
-        //Blocks vector 0th block is the center
-        Block blocks[4];
-
-        //Relative position
-        int x, y;
-
-        //Flip mode
-        int flipmode;
-
-};
-
-Shape::Shape(SDL_Renderer *gRenderer, int shape_type)
+bool Shape::tryMove(const Board &board, int dx, int dy)
 {
-    if (shape_type == -1)
-    {
-        int randno = rand() % SHAPE_TOTAL;
-        //Set shape type
-        type = Shapes(randno);
-
-        //Set shape color
-        color = Colors(randno);
-    }
-    else
-    {
-        //Set shape type
-        type = Shapes(shape_type);
+    if (board.collides(getOrientation().mask, SHAPE_BOX, x + dx, y + dy))
+        return false;
 
-        //Set shape color
-        color = Colors(shape_type);
-    }
-
-    switch(type)
-    {
-        case S_SHAPE:
-        blocks[1].updateOffset(0, -1);
-        blocks[2].updateOffset(-1, 0);
-        blocks[3].updateOffset(-1, 1);
-        break;
-
-        case Z_SHAPE:
-        blocks[1].updateOffset(0, -1);
-        blocks[2].updateOffset(1, 0);
-        blocks[3].updateOffset(-1, -1);
-        break;
-
-        case T_SHAPE:
-        blocks[1].updateOffset(0, -1);
-        blocks[2].updateOffset(-1, 0);
-        blocks[3].updateOffset(1, 0);
-        break;
-        
-        case L_SHAPE:
-        blocks[1].updateOffset(0, -1);
-        blocks[2].updateOffset(0, -2);
-        blocks[3].updateOffset(1, 0);
-        break;
-
-        case I_SHAPE:
-        blocks[1].updateOffset(0, -1);
-        blocks[2].updateOffset(0, -2);
-        blocks[3].updateOffset(0, 1);
-        break;
-
-        case ML_SHAPE:
-        blocks[1].updateOffset(0, -1);
-        blocks[2].updateOffset(0, -2);
-        blocks[3].updateOffset(-1, 0);
-        break;
-
-        case SQR_SHAPE:
-        blocks[1].updateOffset(0, 1);
-        blocks[2].updateOffset(1, 0);
-        blocks[3].updateOffset(1, 1);
-        break;
-    }
+    setRelativePosition(x + dx, y + dy);
+    return true;
 }
 
-bool Shape::loadFromFile(SDL_Renderer *gRenderer)
+void Shape::moveLeft(const Board &board)
 {
-    std::string filepath;
-    switch(color)
-    {
-        case BLUE:
-        filepath = "Assets/Textures/Blocks/Blue_Block.png";
-        break;
-
-        case GREEN:
-        filepath = "Assets/Textures/Blocks/Green_Block.png";
-        break;
-
-        case PURPLE:
-        filepath = "Assets/Textures/Blocks/Purple_Block.png";
-        break;
-
-        case PINK:
-        filepath = "Assets/Textures/Blocks/Pink_Block.png";
-        break;
-
-        case RED:
-        filepath = "Assets/Textures/Blocks/Red_Block.png";
-        break;
-
-        case TEAL:
-        filepath = "Assets/Textures/Blocks/Teal_Block.png";
-        break;
-
-        case YELLOW:
-        filepath = "Assets/Textures/Blocks/Yellow_Block.png";
-        break;
-    }
-
-    for (int i = 0; i < 4; i++)
-        blocks[i].loadFromFile(gRenderer, filepath);
+    tryMove(board, -1, 0);
 }
 
-
-Shape::~Shape()
+void Shape::moveRight(const Board &board)
 {
-    x = y = 0;
+    tryMove(board, 1, 0);
 }
 
-void Shape::setRelativePosition(int x, int y)
+void Shape::moveDown(const Board &board)
 {
-    this->x = x;
-    this->y = y;
-    for (int i = 0; i < 4; i++)
-        blocks[i].setCentrePosition(x, y);
+    tryMove(board, 0, 1);
 }
 
-void Shape::getRelativePosition(int &x, int &y)
+void Shape::hardDrop(const Board &board)
 {
-    x = this->x;
-    y = this->y;
+    setRelativePosition(x, y + dropDistance(board));
 }
 
-void Shape::render(SDL_Renderer *gRenderer, int grid_x, int grid_y)
+int Shape::dropDistance(const Board &board) const
 {
-    for (int i = 0; i < 4; i++)
-        blocks[i].render(gRenderer, grid_x, grid_y);
+    return board.dropDistance(getOrientation().mask, SHAPE_BOX, x, y);
 }
 
-void Shape::moveLeft()
+void Shape::rotateByPi2(const Board &board)
 {
-    bool outside_grid = false;
-    for (int i = 0; i < 4; i++)
-    {
-        int x, y;
-        blocks[i].getCentrePosition(x, y);
-        blocks[i].setCentrePosition(x - 1, y);
-        if (!blocks[i].checkGrid())
-            outside_grid = true;
-        blocks[i].setCentrePosition(x, y);
-    }
+    const Orientation &current = getOrientation();
+    int next = (rotation + 1) % ROTATION_TOTAL;
+    const uint16_t *mask = ::getOrientation(type, next).mask;
 
-    if (!outside_grid)
+    //Try each wall kick until one fits
+    for (int i = 0; i < KICK_TOTAL; i++)
     {
-        for (int i = 0; i < 4; i++)
+        int kx = x + current.kicks[i].x;
+        int ky = y + current.kicks[i].y;
+        if (!board.collides(mask, SHAPE_BOX, kx, ky))
         {
-            int x, y;
-            blocks[i].getCentrePosition(x, y);
-            blocks[i].setCentrePosition(x - 1, y);
-        }   
+            rotation = next;
+            setRelativePosition(kx, ky);
+            return;
+        }
     }
 }
 
-void Shape::moveRight()
+void Shape::flipAngle(const Board &board)
 {
-    bool outside_grid = false;
-    for (int i = 0; i < 4; i++)
-    {
-        int x, y;
-        blocks[i].getCentrePosition(x, y);
-        blocks[i].setCentrePosition(x + 1, y);
-        if (!blocks[i].checkGrid())
-            outside_grid = true;
-        blocks[i].setCentrePosition(x, y);
-    }
-
-    if (!outside_grid)
-    {
-        for (int i = 0; i < 4; i++)
-        {
-            int x, y;
-            blocks[i].getCentrePosition(x, y);
-            blocks[i].setCentrePosition(x + 1, y);
-        }   
-    }
+    //The square looks the same in every orientation
+    if (type != SQR_SHAPE)
+        rotateByPi2(board);
 }
 
-void Shape::moveDown()
+bool Shape::checkSettled(const Board &board) const
 {
-    bool outside_grid = false;
-    for (int i = 0; i < 4; i++)
-    {
-        int x, y;
-        blocks[i].getCentrePosition(x, y);
-        blocks[i].setCentrePosition(x, y + 1);
-        if (!blocks[i].checkGrid())
-            outside_grid = true;
-        blocks[i].setCentrePosition(x, y);
-    }
-
-    if (!outside_grid)
-    {
-        for (int i = 0; i < 4; i++)
-        {
-            int x, y;
-            blocks[i].getCentrePosition(x, y);
-            blocks[i].setCentrePosition(x, y + 1);
-        }   
-    }
+    return board.collides(getOrientation().mask, SHAPE_BOX, x, y + 1);
 }
 
-void Shape::rotateByPi2()
+bool Shape::checkBlocked(const Board &board) const
 {
-    int off_x, off_y;
-    int off_x_rot, off_y_rot;
-    bool outside_grid = false;
-    for (int i = 1; i < 4; i++)
-    {
-        blocks[i].getOffsetPosition(off_x, off_y);
-        off_x_rot = off_x * 0 + off_y * -1;
-        off_y_rot = off_x * 1 + off_y * 0;
-        blocks[i].updateOffset(off_x_rot, off_y_rot);
-        if (!blocks[i].checkGrid())
-            outside_grid = true;
-        blocks[i].updateOffset(off_x, off_y);
-    }
-
-    if (!outside_grid)
-    {
-        for (int i = 1; i < 4; i++)
-        {
-            blocks[i].getOffsetPosition(off_x, off_y);
-            off_x_rot = off_x * 0 + off_y * -1;
-            off_y_rot = off_x * 1 + off_y * 0;
-            blocks[i].updateOffset(off_x_rot, off_y_rot);
-        }
-    }
+    return board.collides(getOrientation().mask, SHAPE_BOX, x, y);
 }
 
-void Shape::flipAngle()
+void Shape::lock(Board &board) const
 {
-    switch(type)
-    {
-        case S_SHAPE:
-        case I_SHAPE:
-        case Z_SHAPE:
-        rotateByPi2();
-        break;
-
-        case T_SHAPE:
-        case L_SHAPE:
-        case ML_SHAPE:
-        rotateByPi2();
-        break;
-    }
+    board.place(getOrientation().mask, SHAPE_BOX, x, y, color);
 }
 
-bool Shape::checkSettled(int grid[GRID_HEIGHT][GRID_WIDTH])
+void Shape::writeState(StateWriter &out) const
 {
-    for (int i = 0; i < 4; i++)
-    {
-        if (blocks[i].checkSettled(grid))
-            return true;
-    }
-    return false;
+    out.u8(type);
+    out.u8(rotation);
+    out.u8((uint8_t)x);
+    out.u8((uint8_t)y);
 }
 
-void Shape::purgeBlocks(std::vector<Block> &renderQueue)
+bool Shape::readState(StateReader &in)
 {
-    for (int i = 0; i < 4; i++)
-    {
-        Block newblock = blocks[i];
-        renderQueue.push_back(newblock);
-    }
-}
\ No newline at end of file
+    uint8_t newType = in.u8();
+    uint8_t newRotation = in.u8();
+    int newX = (int8_t)in.u8();
+    int newY = (int8_t)in.u8();
+
+    //The position is shifted into padded rows, so it has to stay within a box of the walls
+    if (newType >= SHAPE_TOTAL || newRotation >= ROTATION_TOTAL || newX < -BOARD_WALL || newX > GRID_WIDTH ||
+        newY < -SHAPE_BOX || newY >= GRID_HEIGHT)
+        return false;
+
+    type = Shapes(newType);
+    color = Colors(newType);
+    rotation = newRotation;
+    x = newX;
+    y = newY;
+    return true;
+}
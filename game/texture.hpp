@@ -3,16 +3,49 @@
 #include <SDL2/SDL_image.h>
 #include <string>
 
+#ifndef TRACE_H
+#include "trace.hpp"
+#endif
+
+#ifndef REGISTRY_H
+#include "registry.hpp"
+#endif
+
 #define TEXTURE_H
 
+//Non-owning reference to part of a texture, cheap to copy and only valid while the owner lives
+struct TextureView
+{
+    //Texture owned by an LTexture
+    SDL_Texture *texture;
+
+    //Region of the texture
+    SDL_Rect clip;
+
+    //Draw the region with its top left corner at a point
+    void render(SDL_Renderer *gRenderer, int x, int y) const;
+};
+
+void TextureView::render(SDL_Renderer *gRenderer, int x, int y) const
+{
+    SDL_Rect dst = { x, y, clip.w, clip.h };
+    SDL_RenderCopy(gRenderer, texture, &clip, &dst);
+}
+
+//Owns one hardware texture, move-only so a texture is destroyed exactly once
 class LTexture 
 {
     public:
         //Constructor
         LTexture();
 
-        //Copy constructor
-        LTexture(const LTexture &t);
+        //Take over the texture of another, leaving it empty
+        LTexture(LTexture &&t) noexcept;
+        LTexture &operator=(LTexture &&t) noexcept;
+
+        //Copies would destroy the texture twice, hand out a TextureView instead
+        LTexture(const LTexture &t) = delete;
+        LTexture &operator=(const LTexture &t) = delete;
 
         //Destructor
         ~LTexture();
@@ -20,6 +53,9 @@ class LTexture
         //Load image into texture
         bool loadFromFile( SDL_Renderer *gRenderer, std::string path );
 
+        //Create texture from surface pixels, the surface stays owned by the caller
+        bool loadFromSurface( SDL_Renderer *gRenderer, SDL_Surface *surface );
+
         //Dealocates texture
         void free();
 
@@ -44,6 +80,12 @@ class LTexture
         int getWidth();
         int getHeight();
 
+        //Gets the hardware texture
+        SDL_Texture *getTexture();
+
+        //Get a view of the whole texture, or of clip
+        TextureView view(const SDL_Rect *clip = NULL);
+
         //Set Position
         void setPosition(int x, int y);
 
@@ -71,12 +113,31 @@ LTexture::LTexture()
     mPosition.y = 0;
 }
 
-LTexture::LTexture(const LTexture &t)
+LTexture::LTexture(LTexture &&t) noexcept
 {
     mTexture = t.mTexture;
     mPosition = t.mPosition;
     mWidth = t.mWidth;
     mHeight = t.mHeight;
+    t.mTexture = NULL;
+    t.mWidth = 0;
+    t.mHeight = 0;
+}
+
+LTexture &LTexture::operator=(LTexture &&t) noexcept
+{
+    if (this != &t)
+    {
+        free();
+        mTexture = t.mTexture;
+        mPosition = t.mPosition;
+        mWidth = t.mWidth;
+        mHeight = t.mHeight;
+        t.mTexture = NULL;
+        t.mWidth = 0;
+        t.mHeight = 0;
+    }
+    return *this;
 }
 
 LTexture::~LTexture() 
@@ -98,32 +159,38 @@ void LTexture::getPosition(int &x, int &y)
 
 bool LTexture::loadFromFile( SDL_Renderer *gRenderer, std::string path ) 
 {
-    //Delete the previous texture
-    free();
-    SDL_Texture* newTexture = NULL;
-    //Surface to store the image
-    SDL_Surface* loadedSurface = IMG_Load(path.c_str());
+    TRACE_ZONE("LTexture::loadFromFile");
+    //Surface to store the image, resolved through the asset registry
+    SDL_Surface* loadedSurface = loadSurface(path);
     if ( loadedSurface == NULL )
-        printf( "Unable to load image! SDL Error: %s\n", IMG_GetError() );
-    
-    else 
     {
-        //Create texture from surface pixels
+        free();
+        return false;
+    }
 
-        //SDL_SetColorKey(loadedSurface, SDL_TRUE, SDL_MapRGB( loadedSurface->format, 0, 0xFF, 0xFF ));
-        newTexture = SDL_CreateTextureFromSurface(gRenderer, loadedSurface);
-        if (newTexture == NULL) 
-            printf("Unable to create texture! SDL Error:%s\n", SDL_GetError());
+    bool success = loadFromSurface(gRenderer, loadedSurface);
 
-        else 
-        {
-            //Store image dimesions
-            mWidth = loadedSurface->w;
-            mHeight = loadedSurface->h;
-        }
-        
-        //get rid of old surface
-        SDL_FreeSurface(loadedSurface);
+    //get rid of old surface
+    SDL_FreeSurface(loadedSurface);
+    return success;
+}
+
+bool LTexture::loadFromSurface( SDL_Renderer *gRenderer, SDL_Surface *surface )
+{
+    TRACE_ZONE("LTexture::loadFromSurface");
+    //Delete the previous texture
+    free();
+
+    //Create texture from surface pixels
+    SDL_Texture* newTexture = SDL_CreateTextureFromSurface(gRenderer, surface);
+    if (newTexture == NULL) 
+        printf("Unable to create texture! SDL Error:%s\n", SDL_GetError());
+
+    else 
+    {
+        //Store image dimesions
+        mWidth = surface->w;
+        mHeight = surface->h;
     }
     mTexture = newTexture;
     return mTexture != NULL;
@@ -135,6 +202,7 @@ void LTexture::free()
     if (mTexture != NULL) 
     {
         SDL_DestroyTexture( mTexture );
+        mTexture = NULL;
         mHeight = 0;
         mWidth = 0;
     }
@@ -207,3 +275,16 @@ int LTexture::getWidth()
 {
     return mWidth;
 }
+
+SDL_Texture *LTexture::getTexture()
+{
+    return mTexture;
+}
+
+TextureView LTexture::view(const SDL_Rect *clip)
+{
+    TextureView v = { mTexture, { 0, 0, mWidth, mHeight } };
+    if (clip != NULL)
+        v.clip = *clip;
+    return v;
+}
@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifndef ALLOC_H
+#include "alloc.hpp"
+#endif
+
+#define TRACE_H
+
+//Events kept per thread, the oldest are overwritten once the ring is full
+const uint32_t TRACE_EVENTS = 1 << 16;
+
+//One finished zone, times in nanoseconds since tracing started
+struct TraceEvent
+{
+    const char *name;
+    int64_t begin;
+    int64_t end;
+
+    //Heap allocations made inside the zone, counted when TRACK_ALLOCATIONS is defined
+    AllocStats allocs;
+};
+
+//Ring of events written by a single thread, allocated once on its first event
+struct TraceBuffer
+{
+    TraceEvent events[TRACE_EVENTS];
+    uint32_t next;
+    int thread;
+};
+
+//Flag every zone checks, zones cost one load and a branch while it is clear
+std::atomic<bool> traceEnabled(false);
+
+//Start of the trace clock
+std::chrono::steady_clock::time_point traceEpoch;
+
+//Buffers of every thread that recorded an event, guarded by traceMutex
+std::mutex traceMutex;
+std::vector<TraceBuffer *> traceBuffers;
+
+//Buffer of the calling thread
+thread_local TraceBuffer *traceLocal = NULL;
+
+//Get nanoseconds since tracing started
+int64_t traceNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - traceEpoch).count();
+}
+
+//Allocate the buffer of the calling thread if it has none
+void traceReserve()
+{
+    if (traceLocal != NULL)
+        return;
+
+    //The buffer belongs to the tooling, so it is allowed inside strict scopes
+    AllocScope permit(NULL);
+    std::lock_guard<std::mutex> lock(traceMutex);
+    traceLocal = new TraceBuffer;
+    traceLocal->next = 0;
+    traceLocal->thread = (int)traceBuffers.size() + 1;
+    traceBuffers.push_back(traceLocal);
+}
+
+//Start recording zones, the calling thread gets its buffer right away
+void traceStart()
+{
+    traceReserve();
+    traceEpoch = std::chrono::steady_clock::now();
+    traceEnabled.store(true, std::memory_order_relaxed);
+}
+
+//Append a finished zone to the buffer of the calling thread
+void traceRecord(const char *name, int64_t begin, int64_t end, AllocStats allocs)
+{
+    traceReserve();
+
+    TraceEvent &event = traceLocal->events[traceLocal->next++ & (TRACE_EVENTS - 1)];
+    event.name = name;
+    event.begin = begin;
+    event.end = end;
+    event.allocs = allocs;
+}
+
+//Stop recording and write every buffer as Chrome trace JSON, for chrome://tracing or Perfetto
+bool traceWrite(std::string path)
+{
+    traceEnabled.store(false, std::memory_order_relaxed);
+
+    FILE *file = fopen(path.c_str(), "w");
+    if (file == NULL)
+    {
+        printf("Unable to write trace %s!\n", path.c_str());
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(traceMutex);
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    bool first = true;
+    for (TraceBuffer *buffer: traceBuffers)
+    {
+        //Oldest event first
+        uint32_t count = buffer->next < TRACE_EVENTS ? buffer->next : TRACE_EVENTS;
+        for (uint32_t i = buffer->next - count; i != buffer->next; i++)
+        {
+            const TraceEvent &event = buffer->events[i & (TRACE_EVENTS - 1)];
+            fprintf(file, "%s\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f", first ? "" : ",",
+                    event.name, buffer->thread, event.begin / 1000.0, (event.end - event.begin) / 1000.0);
+            if (allocTracking())
+                fprintf(file, ", \"args\": {\"allocs\": %llu, \"bytes\": %llu}", (unsigned long long)event.allocs.count,
+                        (unsigned long long)event.allocs.bytes);
+            fprintf(file, "}");
+            first = false;
+        }
+    }
+    fprintf(file, "\n]}\n");
+    return fclose(file) == 0;
+}
+
+//Records the time between its construction and destruction while tracing is enabled
+class TraceZone
+{
+    public:
+        //Constructor, name must outlive the trace
+        TraceZone(const char *name);
+
+        //Destructor
+        ~TraceZone();
+
+    private:
+        //Zone name, NULL when tracing was off at the start of the zone
+        const char *name;
+
+        //Start time
+        int64_t begin;
+
+        //Allocations of the thread at the start
+        AllocStats allocs;
+};
+
+TraceZone::TraceZone(const char *name)
+{
+    if (!traceEnabled.load(std::memory_order_relaxed))
+    {
+        this->name = NULL;
+        return;
+    }
+    this->name = name;
+    allocs = allocSnapshot();
+    begin = traceNow();
+}
+
+TraceZone::~TraceZone()
+{
+    if (name != NULL)
+        traceRecord(name, begin, traceNow(), allocSince(allocs));
+}
+
+//Time the rest of the enclosing scope, build with -DNO_TRACE to compile every zone out
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#ifdef NO_TRACE
+#define TRACE_ZONE(name)
+#else
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(traceZone, __LINE__)(name)
+#endif
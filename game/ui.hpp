@@ -8,14 +8,18 @@
 #include "texture.hpp"
 #endif
 
+#ifndef CACHE_H
+#include "cache.hpp"
+#endif
+
 class LButton 
 {
     public:
         //Initializes internal variables
         LButton();
 
-        //Load texture from file
-        bool loadFromFile(SDL_Renderer *gRenderer, std::string path);
+        //Load texture through the cache
+        bool loadFromFile(SDL_Renderer *gRenderer, TextureCache &cache, std::string path);
 
         //Set top left position
         void setPosition( int x, int y );
@@ -26,15 +30,15 @@ class LButton
         //Shows button sprite
         void render(SDL_Renderer *gRenderer);
 
-        //Free texture
+        //Release texture
         void free();
 
     private:
         //Top left position
         SDL_Point mPosition;
 
-        //Button Texture
-        LTexture texture;
+        //Button Texture, owned by the cache
+        TextureView texture;
 
         //Button Name
         std::string name;
@@ -44,18 +48,22 @@ LButton::LButton()
 {
     mPosition.x = 0;
     mPosition.y = 0;
+    free();
 }
 
 void LButton::setPosition(int x, int y) 
 {
     mPosition.x = x;
     mPosition.y = y;
-    texture.setPosition(x, y);
 }
 
 void LButton::free()
 {
-    texture.free();
+    texture.texture = NULL;
+    texture.clip.x = 0;
+    texture.clip.y = 0;
+    texture.clip.w = 0;
+    texture.clip.h = 0;
 }
 
 bool LButton::handleEvent(SDL_Event* e) 
@@ -69,7 +77,7 @@ bool LButton::handleEvent(SDL_Event* e)
         bool inside = false;
 
         //Check if mouse is inside button
-        if (x >= mPosition.x && x <= mPosition.x + texture.getWidth() && y >= mPosition.y && y <= mPosition.y + texture.getHeight())
+        if (texture.texture != NULL && x >= mPosition.x && x <= mPosition.x + texture.clip.w && y >= mPosition.y && y <= mPosition.y + texture.clip.h)
             inside = true;
 
         //Mouse is outside button
@@ -80,17 +88,21 @@ bool LButton::handleEvent(SDL_Event* e)
         else
             return true;
     }
+    return false;
 }
 
-bool LButton::loadFromFile(SDL_Renderer *gRenderer, std::string path)
+bool LButton::loadFromFile(SDL_Renderer *gRenderer, TextureCache &cache, std::string path)
 {
-    if (!texture.loadFromFile(gRenderer, path)) return false;
+    LTexture *loaded = cache.get(gRenderer, path);
+    if (loaded == NULL) return false;
+    texture = loaded->view();
     return true;
 }
 
 void LButton::render(SDL_Renderer *gRenderer)
 {
-    texture.render(gRenderer);
+    if (texture.texture != NULL)
+        texture.render(gRenderer, mPosition.x, mPosition.y);
 }
 
 